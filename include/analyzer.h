@@ -0,0 +1,94 @@
+//
+// CHIP-8 emulator
+//
+// By Jaldhar H. Vyas <jaldhar@braincells.com>
+// Copyright (C) 2021, Consolidated Braincells Inc.  All rights reserved.
+// "Do what thou wilt" shall be the whole of the license.
+//
+
+#ifndef ANALYZER_H
+#define ANALYZER_H
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "opcodes.h"
+#include "vm.h"
+
+class Rom;
+
+// Works out statically which parts of a ROM are code and which are data by
+// following every path of execution from PROGRAM_START.  Along the way it
+// keeps track of I wherever it is set by a constant (ANNN) so that sprites
+// and tables read by DXYN and FX65 can be marked as data, and writes by FX33
+// and FX55 can be checked against the code.  Anything it can't be sure of,
+// such as BNNN or a write through an unknown I, is noted.
+class Analyzer {
+public:
+    enum class Kind : uint8_t {
+        UNKNOWN,    // never reached or referred to
+        CODE,
+        DATA
+    };
+
+    // A run of instructions which is only entered at the top and only left
+    // at the bottom.
+    struct Block {
+        uint16_t                start;
+        uint16_t                end;        // one past the last instruction
+        Flow                    flow;       // of the last instruction
+        std::vector<uint16_t>   successors;
+    };
+
+    struct Note {
+        uint16_t    address;
+        std::string text;
+    };
+
+    explicit Analyzer(const Rom&, const Quirks& = Quirks{});
+
+    const std::vector<Block>&   blocks() const;
+    uint8_t                     byteAt(uint16_t) const;
+    uint16_t                    end() const;
+    bool                        hasIndirectJumps() const;
+    bool                        hasSelfModifyingCode() const;
+    bool                        isInstruction(uint16_t) const;
+    bool                        isLeader(uint16_t) const;
+    Kind                        kindAt(uint16_t) const;
+    const std::vector<Note>&    notes() const;
+    uint16_t                    wordAt(uint16_t) const;
+
+private:
+    using Image = std::array<uint8_t, MEM_SIZE>;
+    using Kinds = std::array<Kind, MEM_SIZE>;
+    using Flags = std::bitset<MEM_SIZE>;
+
+    struct Write {
+        uint16_t    from;           // the FX33 or FX55
+        uint16_t    address;
+        int         length;
+    };
+
+    void        checkWrites();
+    void        findBlocks();
+    void        mark(uint16_t address, int length, Kind);
+    void        note(uint16_t address, const std::string&);
+    void        trace(uint16_t entry, std::vector<uint16_t>& pending);
+
+    Image               image_;
+    uint16_t            end_;           // one past the last byte of the ROM
+    Quirks              quirks_;
+    Kinds               kinds_;
+    Flags               instructions_;  // first byte of an instruction
+    Flags               leaders_;       // first instruction of a block
+    std::vector<Write>  writes_;
+    std::vector<Block>  blocks_;
+    std::vector<Note>   notes_;
+    bool                indirect_;
+    bool                selfModifying_;
+};
+
+#endif
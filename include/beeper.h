@@ -0,0 +1,73 @@
+//
+// CHIP-8 emulator
+//
+// By Jaldhar H. Vyas <jaldhar@braincells.com>
+// Copyright (C) 2021, Consolidated Braincells Inc.  All rights reserved.
+// "Do what thou wilt" shall be the whole of the license.
+//
+
+#ifndef BEEPER_H
+#define BEEPER_H
+
+#include <atomic>
+#include <cstdint>
+#include "spsc.h"
+
+// Generates the CHIP-8 tone one sample at a time.
+//
+// The emulation thread pushes sound on and off events timestamped in
+// emulated cycles and regularly publishes how far emulation has got.  The
+// audio thread follows the same timeline a little way behind so each edge
+// lands on the exact sample it belongs to.  The rate at which the audio
+// thread moves along the timeline is nudged up or down to keep that distance
+// steady so that the host's audio clock and the emulation clock cannot drift
+// apart.
+class Beeper {
+public:
+    explicit Beeper(uint32_t sampleRate, float frequency,
+        double cyclesPerSecond);
+
+    // Emulation thread.  push() returns false, dropping the edge, if the
+    // queue is full.
+    void    advance(uint64_t cycle);
+    bool    push(uint64_t cycle, bool on);
+    void    setCycleRate(double cyclesPerSecond);
+    void    setSpeed(double);
+
+    // Audio thread.
+    float   sample();
+
+    // Offline rendering, in place of sample().  The cycle must not be ahead
+    // of the events pushed so far.
+    float   sampleAt(double cycle);
+
+    // Either thread.
+    double  latency() const;
+
+private:
+    struct Event {
+        uint64_t    cycle;
+        bool        on;
+    };
+
+    void    follow();
+    void    applyEvents();
+    float   tone();
+
+    SPSCQueue<Event, 256>   events_;
+    std::atomic<uint64_t>   now_;           // latest cycle emulated
+    std::atomic<double>     cyclesPerSecond_;
+    std::atomic<double>     speed_;         // 1 = normal, >1 = fast-forward
+    std::atomic<double>     latency_;       // seconds the audio is behind
+
+    uint32_t                sampleRate_;
+    double                  cursor_;        // cycle at the current sample
+    double                  lag_;           // smoothed now_ - cursor_
+    bool                    on_;
+    double                  phase_;         // position in the current wave
+    double                  step_;          // phase increment per sample
+    float                   level_;         // current amplitude; 0 - 1
+    float                   ramp_;          // amplitude change per sample
+};
+
+#endif
@@ -0,0 +1,80 @@
+//
+// CHIP-8 emulator
+//
+// By Jaldhar H. Vyas <jaldhar@braincells.com>
+// Copyright (C) 2021, Consolidated Braincells Inc.  All rights reserved.
+// "Do what thou wilt" shall be the whole of the license.
+//
+
+#ifndef CHIP8ENV_H
+#define CHIP8ENV_H
+
+// A C interface for using the VM as a reinforcement learning environment.
+// It is built into libchip8.so so it can be used from other languages, e.g.
+// Python with ctypes.
+//
+// An action is the set of keys held down, one bit per key.  An observation
+// is the display packed into CHIP8_OBSERVATION_SIZE bytes: 8 bytes per row,
+// top row first, with the leftmost pixel of each byte in its highest bit.
+// The reward for a step is how much the value at the configured address in
+// memory changed.  An episode is done if the VM faults.
+//
+// Functions which return a pointer return NULL if they fail.  Creating and
+// cloning environments allocate memory.  Copying, resetting, stepping and
+// observing them don't, except that a step in which a compiled ROM
+// overwrites its own code makes a new copy of the table of compiled code.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CHIP8_OBSERVATION_SIZE  256
+
+#define CHIP8_QUIRK_LOGIC       0x01
+#define CHIP8_QUIRK_SHIFT       0x02
+#define CHIP8_QUIRK_MEMORY      0x04    // memoryLeaveIUnchanged
+#define CHIP8_QUIRK_JUMP        0x08
+#define CHIP8_QUIRK_WRAP        0x10
+
+typedef struct chip8_config {
+    int         tickrate;       // instructions per frame
+    unsigned    quirks;         // CHIP8_QUIRK_* bits
+    int         reward_address; // where the score is kept in memory
+    int         reward_size;    // 1 or 2 bytes (big-endian) or 0 for none
+} chip8_config;
+
+typedef struct chip8_env chip8_env;
+typedef struct chip8_vec chip8_vec;
+
+void        chip8_config_default(chip8_config* config);
+
+chip8_env*  chip8_env_create(const uint8_t* rom, size_t size,
+                const chip8_config* config);
+chip8_env*  chip8_env_clone(const chip8_env* env);
+void        chip8_env_copy(chip8_env* to, const chip8_env* from);
+void        chip8_env_destroy(chip8_env* env);
+void        chip8_env_observe(const chip8_env* env, uint8_t* observation);
+void        chip8_env_reset(chip8_env* env, uint32_t seed);
+float       chip8_env_step(chip8_env* env, uint16_t action, int frameskip,
+                int* done);
+
+// A set of environments which are stepped together by a pool of threads.
+// observations must have room for count * CHIP8_OBSERVATION_SIZE bytes and
+// rewards and dones for count entries.  threads <= 0 means one per CPU.
+chip8_vec*  chip8_vec_create(const uint8_t* rom, size_t size,
+                const chip8_config* config, int count, int threads);
+void        chip8_vec_destroy(chip8_vec* vec);
+chip8_env*  chip8_vec_env(chip8_vec* vec, int index);
+void        chip8_vec_reset(chip8_vec* vec, const uint32_t* seeds);
+void        chip8_vec_step(chip8_vec* vec, const uint16_t* actions,
+                int frameskip, uint8_t* observations, float* rewards,
+                uint8_t* dones);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,73 @@
+//
+// CHIP-8 emulator
+//
+// By Jaldhar H. Vyas <jaldhar@braincells.com>
+// Copyright (C) 2021, Consolidated Braincells Inc.  All rights reserved.
+// "Do what thou wilt" shall be the whole of the license.
+//
+
+#ifndef COMPILED_H
+#define COMPILED_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "opcodes.h"
+#include "vm.h"
+
+// Support for ROMs which have been compiled ahead of time to C++ by chip8aot.
+// A compiled ROM is a set of functions, one per basic block, which are run
+// by Chip8VM::run() instead of interpreting the instructions one by one.
+// Anything which isn't the start of a compiled block, such as the target of
+// a BNNN, is still interpreted.
+
+using CompiledFunction = void (*)(Chip8VM&);
+
+struct CompiledBlock {
+    uint16_t            start;
+    uint16_t            length;     // number of instructions
+    CompiledFunction    run;
+};
+
+struct CompiledRom {
+    const char*             hash;   // SHA-1 of the ROM it was compiled from
+    const CompiledBlock*    blocks;
+    std::size_t             count;
+};
+
+// Generated code registers its CompiledRom when the program starts.
+bool                registerCompiledRom(const CompiledRom&);
+const CompiledRom*  findCompiledRom(const std::string& hash);
+
+// What compiled blocks are built from.  Each instruction is run by the same
+// Chip8VM method the interpreter uses; as the address and opcode are
+// constants in generated code, the compiler can resolve the call and the
+// decoding of the operands at compile time.
+class Runtime {
+public:
+    explicit Runtime(Chip8VM& vm) : vm_{vm} {
+    }
+
+    void execute(uint16_t address, uint16_t word) {
+        vm_.PC_ = address + 2;
+        (vm_.*Chip8VM::HANDLERS[static_cast<uint8_t>(decodeOp(word))])(
+            Chip8VM::Instruction {
+                static_cast<uint16_t>((word & 0xF000) >> 12),
+                {{ static_cast<uint16_t>(word & 0x0FFF) }}
+            });
+        vm_.cycles_++;
+    }
+
+    // False if the block starting at start has been invalidated because
+    // the program wrote over it.  Generated code checks this after each
+    // instruction which writes memory and stops if so.
+    bool valid(uint16_t start) const {
+        return vm_.compiled_ && (*vm_.compiled_)[start & MEM_MASK];
+    }
+
+private:
+    Chip8VM&    vm_;
+};
+
+#endif
@@ -0,0 +1,90 @@
+//
+// CHIP-8 emulator
+//
+// By Jaldhar H. Vyas <jaldhar@braincells.com>
+// Copyright (C) 2021, Consolidated Braincells Inc.  All rights reserved.
+// "Do what thou wilt" shall be the whole of the license.
+//
+
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "vm.h"
+
+// Controls a Chip8VM from a text command interface.  Commands can be given
+// directly through execute() or typed at a console on stdin or on a TCP
+// port on localhost.  Console commands are queued and run by poll() so that
+// the VM is only ever touched from the thread which runs it.
+//
+// While a Debugger is in use, the VM should be run through its cycle() and
+// handleInterrupts() rather than the VM's own.
+class Debugger {
+public:
+    explicit Debugger(Chip8VM&);
+    ~Debugger();
+    Debugger(const Debugger&) = delete;
+    Debugger& operator=(const Debugger&) = delete;
+
+    void        cycle();
+    std::string execute(const std::string& command);
+    void        handleInterrupts();
+    void        listen(uint16_t port);
+    void        listenStdin();
+    bool        paused() const;
+    void        poll();
+    std::string status() const;
+
+private:
+    enum class Watch : uint8_t {
+        MEMORY,
+        I,
+        REGISTER
+    };
+
+    struct Watchpoint {
+        Watch       kind;
+        uint16_t    where;      // address or register number
+        uint16_t    value;      // value when last checked
+    };
+
+    struct Request {
+        std::string                 command;
+        std::promise<std::string>   reply;
+    };
+
+    void        checkWatchpoints();
+    std::string memory(uint16_t address, uint16_t length) const;
+    void        notify(const std::string&);
+    void        pause(const std::string& reason);
+    std::string submit(const std::string& command);
+    uint16_t    valueOf(const Watchpoint&) const;
+
+    Chip8VM&                    vm_;
+    bool                        paused_;
+    bool                        stepping_;  // stepping over a call
+    uint16_t                    returnPC_;  // where a stepped-over call returns
+    uint8_t                     returnSP_;
+    std::vector<Watchpoint>     watchpoints_;
+
+    std::mutex                  mutex_;     // guards requests_, closing_
+    std::deque<Request>         requests_;
+    bool                        closing_;   // no more requests are answered
+    std::atomic<bool>           echo_;      // notify on stdout
+    std::mutex                  clientMutex_;   // guards client_
+    int                         client_;    // TCP console socket or -1
+    std::atomic<int>            server_;    // listening socket or -1
+    std::thread                 serverThread_;
+    std::atomic<bool>           stdinDone_; // stdin console thread finished
+    int                         stopStdin_[2];  // pipe; wakes the stdin thread
+    std::thread                 stdinThread_;
+};
+
+#endif
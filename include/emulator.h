@@ -0,0 +1,100 @@
+//
+// CHIP-8 emulator
+//
+// By Jaldhar H. Vyas <jaldhar@braincells.com>
+// Copyright (C) 2021, Consolidated Braincells Inc.  All rights reserved.
+// "Do what thou wilt" shall be the whole of the license.
+//
+
+#ifndef EMULATOR_H
+#define EMULATOR_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include "triplebuffer.h"
+#include "vm.h"
+
+class Beeper;
+class Recorder;
+
+// Takes the copy of the display which is shown.  It should only be taken at
+// the end of each 60Hz frame, like the vertical blank on real hardware,
+// because in between the display is usually half drawn; CHIP-8 programs
+// move sprites by erasing them with XOR and drawing them again.
+//
+// With blending, every pixel which was lit in either of the last two frames
+// is shown so a sprite which is erased and redrawn in alternate frames
+// stays solid too.
+class Latch {
+public:
+    using Frame = std::array<uint64_t, SCREEN_HEIGHT>;  // from displayRow()
+
+    explicit Latch();
+
+    bool        blend() const;
+    void        latch(const Chip8VM&, Frame&);
+    void        setBlend(bool);
+
+private:
+    bool                    blend_;
+    Frame                   previous_;      // not blended
+};
+
+// Runs a VM in real time on a thread of its own, so it keeps to its
+// schedule whatever the thread showing it is doing.  Each 60Hz frame is
+// run in a few slices spread over the frame; the keys are read before each
+// slice.  At the end of the frame the timers tick and the display is
+// published for the other thread to show.
+//
+// Once started, the VM, beeper and recorder must not be used by any other
+// thread until stop() returns.
+class Emulator {
+public:
+    using Frame = Latch::Frame;
+
+    explicit Emulator(Chip8VM&, Beeper&, int tickrate);
+    ~Emulator();
+    Emulator(const Emulator&) = delete;
+    Emulator& operator=(const Emulator&) = delete;
+
+    // Before start().
+    void        setBlend(bool);
+    void        setRecorder(Recorder*);
+
+    void        start();
+    void        stop();
+
+    // Any thread.
+    std::chrono::nanoseconds busy();    // time spent running since last call
+    uint64_t    cycles() const;         // as of the last frame
+    uint8_t     faults() const;         // the VM stops if there are any
+    void        setKeys(uint16_t);
+    void        setSpeed(double);       // 1 = real time, >1 = fast-forward
+
+    // The thread showing the display.  Returns false if there is no new
+    // frame since the last call.
+    bool        frame(Frame&);
+
+private:
+    void        run();
+    void        endFrame();
+
+    Chip8VM&                vm_;
+    Beeper&                 beeper_;
+    Recorder*               recorder_;
+    int                     tickrate_;      // instructions per frame
+    Latch                   latch_;
+    TripleBuffer<Frame>     frames_;
+    std::atomic<uint16_t>   keys_;
+    std::atomic<double>     speed_;
+    std::atomic<bool>       running_;
+    std::atomic<int64_t>    busy_;          // nanoseconds
+    std::atomic<uint64_t>   cycles_;
+    std::atomic<uint8_t>    faults_;
+    std::thread             thread_;
+};
+
+#endif
@@ -0,0 +1,67 @@
+//
+// CHIP-8 emulator
+//
+// By Jaldhar H. Vyas <jaldhar@braincells.com>
+// Copyright (C) 2021, Consolidated Braincells Inc.  All rights reserved.
+// "Do what thou wilt" shall be the whole of the license.
+//
+
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "vm.h"
+
+// Turns the display into an image for the screen.  Pixels are 32-bit RGBA
+// (red in the low byte) as the GUI's textures are.  The image can be bigger
+// than the display; scaleX() and scaleY() say by how much.
+//
+//  none        one pixel per display pixel.
+//  scale2x     the Scale2x (also known as EPX) pixel art scaler which
+//              smooths diagonal edges, 2 by 2 pixels per display pixel.
+//  scale3x     the same at 3 by 3.
+//  scanlines   every fourth line is darkened like an old monitor.
+//  phosphor    pixels fade out over a few frames instead of going dark at
+//              once, which hides the flicker of sprites being erased and
+//              redrawn.
+//
+// The scalers work on a whole row of the display at once, 64 pixels in a
+// uint64_t, using bitwise operations.
+class Filter {
+public:
+    using Rows = std::array<uint64_t, SCREEN_HEIGHT>;  // from displayRow()
+
+    enum class Type { NONE, SCALE2X, SCALE3X, SCANLINES, PHOSPHOR };
+
+    explicit Filter(Type = Type::NONE);
+
+    // Writes the image to pixels, which must have room for width() *
+    // height().  elapsed is the number of 60Hz frames since the last call.
+    // Returns false without writing anything if the image would be the same
+    // as last time.
+    bool        apply(const Rows&, float elapsed, uint32_t* pixels);
+    int         height() const;
+    static bool lookup(const std::string& name, Type&);
+    static std::string names();
+    int         scaleX() const;
+    int         scaleY() const;
+    int         width() const;
+
+private:
+    void        none(uint32_t*) const;
+    void        phosphor(float elapsed, uint32_t*);
+    void        scale2x(uint32_t*) const;
+    void        scale3x(uint32_t*) const;
+    void        scanlines(uint32_t*) const;
+
+    Type                    type_;
+    Rows                    rows_;      // as of the last call
+    bool                    drawn_;     // whether anything has been drawn
+    bool                    fading_;    // phosphor still changing
+    std::vector<float>      levels_;    // phosphor brightness; 0 - 1
+};
+
+#endif
@@ -0,0 +1,194 @@
+//
+// CHIP-8 emulator
+//
+// By Jaldhar H. Vyas <jaldhar@braincells.com>
+// Copyright (C) 2021, Consolidated Braincells Inc.  All rights reserved.
+// "Do what thou wilt" shall be the whole of the license.
+//
+
+#ifndef OPCODES_H
+#define OPCODES_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+// Every operation the VM knows.  The names match the Chip8VM methods which
+// implement them.  Anything which doesn't decode to something else is a
+// NO_OP.
+enum class Op : uint8_t {
+    NO_OP,
+    CLS,
+    RET,
+    JMP,
+    CALL,
+    SKIP_IF_EQ_C,
+    SKIP_IF_NEQ_C,
+    SKIP_IF_EQ_R,
+    MOVE_C,
+    ADD_C,
+    MOVE_R,
+    BITWISE_OR,
+    BITWISE_AND,
+    BITWISE_XOR,
+    ADD_R,
+    SUB_R,
+    SHIFT_RIGHT,
+    SUB_N,
+    SHIFT_LEFT,
+    SKIP_IF_NEQ_R,
+    LOAD_I,
+    JMP_V0,
+    RAND,
+    DRAW,
+    SKIP_IF_KEY,
+    SKIP_IF_NKEY,
+    SAVE_DELAY,
+    WAIT_KEY,
+    LOAD_DELAY,
+    LOAD_SOUND,
+    ADD_I,
+    FONT,
+    BCD,
+    SAVE_REG,
+    LOAD_REG
+};
+
+constexpr static int OP_COUNT = static_cast<int>(Op::LOAD_REG) + 1;
+
+// How an operation affects the flow of control.
+enum class Flow : uint8_t {
+    NEXT,       // carries on with the next instruction
+    SKIP,       // may skip the next instruction
+    JUMP,       // goes to NNN
+    CALL,       // goes to NNN and returns to the next instruction
+    RETURN,     // goes back to wherever it was called from
+    INDIRECT    // goes somewhere which depends on a register
+};
+
+struct OpInfo {
+    const char* mnemonic;
+    const char* operands;   // {x}, {y}, {n}, {nn} and {nnn} are replaced
+    Flow        flow;
+};
+
+// The decoding tables.  Opcodes 0, 8 and E are further decoded by their
+// lowest nibble and F by their lowest byte.
+struct OpTables {
+    std::array<Op, 16>  main;
+    std::array<Op, 16>  table0;
+    std::array<Op, 16>  table8;
+    std::array<Op, 16>  tableE;
+    std::array<Op, 256> tableF;
+};
+
+constexpr OpTables makeOpTables() {
+    OpTables t{};
+
+    t.main[0x1] = Op::JMP;
+    t.main[0x2] = Op::CALL;
+    t.main[0x3] = Op::SKIP_IF_EQ_C;
+    t.main[0x4] = Op::SKIP_IF_NEQ_C;
+    t.main[0x5] = Op::SKIP_IF_EQ_R;
+    t.main[0x6] = Op::MOVE_C;
+    t.main[0x7] = Op::ADD_C;
+    t.main[0x9] = Op::SKIP_IF_NEQ_R;
+    t.main[0xA] = Op::LOAD_I;
+    t.main[0xB] = Op::JMP_V0;
+    t.main[0xC] = Op::RAND;
+    t.main[0xD] = Op::DRAW;
+
+    t.table0[0x0] = Op::CLS;
+    t.table0[0xE] = Op::RET;
+
+    t.table8[0x0] = Op::MOVE_R;
+    t.table8[0x1] = Op::BITWISE_OR;
+    t.table8[0x2] = Op::BITWISE_AND;
+    t.table8[0x3] = Op::BITWISE_XOR;
+    t.table8[0x4] = Op::ADD_R;
+    t.table8[0x5] = Op::SUB_R;
+    t.table8[0x6] = Op::SHIFT_RIGHT;
+    t.table8[0x7] = Op::SUB_N;
+    t.table8[0xE] = Op::SHIFT_LEFT;
+
+    t.tableE[0x1] = Op::SKIP_IF_NKEY;
+    t.tableE[0xE] = Op::SKIP_IF_KEY;
+
+    t.tableF[0x07] = Op::SAVE_DELAY;
+    t.tableF[0x0A] = Op::WAIT_KEY;
+    t.tableF[0x15] = Op::LOAD_DELAY;
+    t.tableF[0x18] = Op::LOAD_SOUND;
+    t.tableF[0x1E] = Op::ADD_I;
+    t.tableF[0x29] = Op::FONT;
+    t.tableF[0x33] = Op::BCD;
+    t.tableF[0x55] = Op::SAVE_REG;
+    t.tableF[0x65] = Op::LOAD_REG;
+
+    return t;
+}
+
+inline constexpr OpTables OPTABLES = makeOpTables();
+
+constexpr Op decodeOp(uint16_t word) {
+    switch (word >> 12) {
+        case 0x0:
+            return OPTABLES.table0[word & 0x000F];
+        case 0x8:
+            return OPTABLES.table8[word & 0x000F];
+        case 0xE:
+            return OPTABLES.tableE[word & 0x000F];
+        case 0xF:
+            return OPTABLES.tableF[word & 0x00FF];
+        default:
+            return OPTABLES.main[word >> 12];
+    }
+}
+
+inline constexpr std::array<OpInfo, OP_COUNT> OPINFO {{
+    { "DW",   "{word}",         Flow::NEXT },       // NO_OP
+    { "CLS",  "",               Flow::NEXT },       // CLS
+    { "RET",  "",               Flow::RETURN },     // RET
+    { "JP",   "{nnn}",          Flow::JUMP },       // JMP
+    { "CALL", "{nnn}",          Flow::CALL },       // CALL
+    { "SE",   "V{x}, {nn}",     Flow::SKIP },       // SKIP_IF_EQ_C
+    { "SNE",  "V{x}, {nn}",     Flow::SKIP },       // SKIP_IF_NEQ_C
+    { "SE",   "V{x}, V{y}",     Flow::SKIP },       // SKIP_IF_EQ_R
+    { "LD",   "V{x}, {nn}",     Flow::NEXT },       // MOVE_C
+    { "ADD",  "V{x}, {nn}",     Flow::NEXT },       // ADD_C
+    { "LD",   "V{x}, V{y}",     Flow::NEXT },       // MOVE_R
+    { "OR",   "V{x}, V{y}",     Flow::NEXT },       // BITWISE_OR
+    { "AND",  "V{x}, V{y}",     Flow::NEXT },       // BITWISE_AND
+    { "XOR",  "V{x}, V{y}",     Flow::NEXT },       // BITWISE_XOR
+    { "ADD",  "V{x}, V{y}",     Flow::NEXT },       // ADD_R
+    { "SUB",  "V{x}, V{y}",     Flow::NEXT },       // SUB_R
+    { "SHR",  "V{x}, V{y}",     Flow::NEXT },       // SHIFT_RIGHT
+    { "SUBN", "V{x}, V{y}",     Flow::NEXT },       // SUB_N
+    { "SHL",  "V{x}, V{y}",     Flow::NEXT },       // SHIFT_LEFT
+    { "SNE",  "V{x}, V{y}",     Flow::SKIP },       // SKIP_IF_NEQ_R
+    { "LD",   "I, {nnn}",       Flow::NEXT },       // LOAD_I
+    { "JP",   "V0, {nnn}",      Flow::INDIRECT },   // JMP_V0
+    { "RND",  "V{x}, {nn}",     Flow::NEXT },       // RAND
+    { "DRW",  "V{x}, V{y}, {n}", Flow::NEXT },      // DRAW
+    { "SKP",  "V{x}",           Flow::SKIP },       // SKIP_IF_KEY
+    { "SKNP", "V{x}",           Flow::SKIP },       // SKIP_IF_NKEY
+    { "LD",   "V{x}, DT",       Flow::NEXT },       // SAVE_DELAY
+    { "LD",   "V{x}, K",        Flow::NEXT },       // WAIT_KEY
+    { "LD",   "DT, V{x}",       Flow::NEXT },       // LOAD_DELAY
+    { "LD",   "ST, V{x}",       Flow::NEXT },       // LOAD_SOUND
+    { "ADD",  "I, V{x}",        Flow::NEXT },       // ADD_I
+    { "LD",   "F, V{x}",        Flow::NEXT },       // FONT
+    { "LD",   "B, V{x}",        Flow::NEXT },       // BCD
+    { "LD",   "[I], V{x}",      Flow::NEXT },       // SAVE_REG
+    { "LD",   "V{x}, [I]",      Flow::NEXT },       // LOAD_REG
+}};
+
+inline const OpInfo& opInfo(Op op) {
+    return OPINFO[static_cast<uint8_t>(op)];
+}
+
+std::string disassemble(uint16_t word);
+
+// value in upper case hexadecimal, padded with zeros to width digits.
+std::string hex(uint64_t value, int width);
+
+#endif
@@ -0,0 +1,168 @@
+//
+// CHIP-8 emulator
+//
+// By Jaldhar H. Vyas <jaldhar@braincells.com>
+// Copyright (C) 2021, Consolidated Braincells Inc.  All rights reserved.
+// "Do what thou wilt" shall be the whole of the license.
+//
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Recycles cache line aligned blocks of memory for objects of type T, such as
+// VMs which are copied and thrown away by the thousand in a search.  Blocks
+// are carved out of chunks which are only freed when the program exits.
+//
+// Each thread keeps its own list of free blocks so allocating and freeing
+// normally doesn't need a lock.  If a thread has too many free blocks, half
+// of them are moved to a list shared by all threads and a thread with none
+// takes some from there before allocating a new chunk.  The blocks a thread
+// frees are the ones it is most likely to have in its cache (and on its NUMA
+// node) already.  When a thread exits, its free blocks are moved to the
+// shared list.
+template<typename T>
+class Pool {
+public:
+    constexpr static std::size_t ALIGNMENT = 64;   // a cache line
+    constexpr static std::size_t BATCH = 32;       // blocks moved at a time
+
+    struct Deleter {
+        void operator()(T* object) const {
+            object->~T();
+            release(object);
+        }
+    };
+
+    using Ptr = std::unique_ptr<T, Deleter>;
+
+    Pool() = delete;
+
+    template<typename... Args>
+    static Ptr make(Args&&... args) {
+        void* block = acquire();
+        try {
+            return Ptr(new (block) T(std::forward<Args>(args)...));
+        } catch (...) {
+            release(block);
+            throw;
+        }
+    }
+
+private:
+    union Block {
+        Block*                                  next;
+        alignas(ALIGNMENT) unsigned char        storage[sizeof(T)];
+    };
+
+    struct List {
+        Block*          head = nullptr;
+        std::size_t     count = 0;
+
+        Block* pop() {
+            Block* block = head;
+            head = block->next;
+            count--;
+            return block;
+        }
+
+        void push(Block* block) {
+            block->next = head;
+            head = block;
+            count++;
+        }
+
+        // Moves up to n blocks to another list.
+        void move(List& to, std::size_t n) {
+            while (head && n--) {
+                to.push(pop());
+            }
+        }
+    };
+
+    struct Shared {
+        Shared() : mutex{}, free{}, chunks{} {
+        }
+
+        ~Shared() {
+            for (auto chunk : chunks) {
+                ::operator delete(chunk, std::align_val_t{ALIGNMENT});
+            }
+        }
+
+        Shared(const Shared&) = delete;
+        Shared& operator=(const Shared&) = delete;
+
+        std::mutex          mutex;      // guards the rest
+        List                free;
+        std::vector<Block*> chunks;
+    };
+
+    struct Local {
+        Local() : free{} {
+        }
+
+        ~Local() {
+            auto& common = shared();
+            std::lock_guard<std::mutex> lock(common.mutex);
+            free.move(common.free, free.count);
+        }
+
+        Local(const Local&) = delete;
+        Local& operator=(const Local&) = delete;
+
+        List    free;
+    };
+
+    static Shared& shared() {
+        static Shared shared;
+        return shared;
+    }
+
+    static Local& local() {
+        thread_local Local local;
+        return local;
+    }
+
+    static void* acquire() {
+        auto& mine = local();
+        if (!mine.free.head) {
+            auto& common = shared();
+            std::lock_guard<std::mutex> lock(common.mutex);
+            common.free.move(mine.free, BATCH);
+
+            if (!mine.free.head) {
+                auto chunk = static_cast<Block*>(::operator new(
+                    sizeof(Block) * BATCH, std::align_val_t{ALIGNMENT}));
+                try {
+                    common.chunks.push_back(chunk);
+                } catch (...) {
+                    ::operator delete(chunk, std::align_val_t{ALIGNMENT});
+                    throw;
+                }
+                for (auto i = BATCH; i > 0; i--) {
+                    mine.free.push(&chunk[i - 1]);
+                }
+            }
+        }
+        return mine.free.pop()->storage;
+    }
+
+    static void release(void* object) {
+        auto& mine = local();
+        mine.free.push(static_cast<Block*>(object));
+        if (mine.free.count > BATCH * 2) {
+            auto& common = shared();
+            std::lock_guard<std::mutex> lock(common.mutex);
+            mine.free.move(common.free, BATCH);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,88 @@
+//
+// CHIP-8 emulator
+//
+// By Jaldhar H. Vyas <jaldhar@braincells.com>
+// Copyright (C) 2021, Consolidated Braincells Inc.  All rights reserved.
+// "Do what thou wilt" shall be the whole of the license.
+//
+
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "spsc.h"
+#include "vm.h"
+
+// Records the display to a video file, one frame per 60Hz tick.  The format
+// is chosen by the extension of the file name: .y4m for uncompressed
+// YUV4MPEG2 or .gif for an animated GIF.  Each frame is scaled up by scale.
+//
+// record() only copies the display into a queue; the frames are encoded and
+// written by a thread of its own so the emulation doesn't wait for the disk.
+// What happens if the encoder falls behind and the queue fills up depends on
+// the mode:
+//
+//  DROP    record() never waits.  The frame is dropped and the one before
+//          it is shown for longer instead so the video keeps time.  For
+//          emulating in real time.
+//  WAIT    record() waits for room so every frame is kept.  For emulating
+//          as fast as possible, when there is no real time to keep up with.
+class Recorder {
+public:
+    enum class Mode { DROP, WAIT };
+
+    explicit Recorder(const char* filename, int scale, Mode = Mode::DROP);
+    ~Recorder();
+    Recorder(const Recorder&) = delete;
+    Recorder& operator=(const Recorder&) = delete;
+
+    // Emulation thread.
+    void        close();
+    uint64_t    dropped() const;
+    void        record(const Chip8VM&);
+
+private:
+    enum class Format { Y4M, GIF };
+
+    using Frame = std::array<uint64_t, SCREEN_HEIGHT>;
+
+    struct Entry {
+        Frame       frame;
+        int         ticks;      // 1 plus the frames dropped before it
+    };
+
+    int     delay(int ticks) const;
+    void    encode();
+    void    writeFrame(const Frame&, int ticks);
+    void    writeGifFrame(const Frame&, int ticks);
+    void    writeGifHeader();
+    void    writeY4MFrame(const Frame&);
+    void    writeY4MHeader();
+
+    SPSCQueue<Entry, 64>    frames_;
+    std::mutex              mutex_;     // for waiting on the queue
+    std::condition_variable ready_;     // a frame was queued or closing_ set
+    std::condition_variable room_;      // a frame was taken off the queue
+    bool                    closing_;   // guarded by mutex_
+    Mode                    mode_;
+    int                     lost_;      // frames dropped since the last kept
+    std::atomic<uint64_t>   dropped_;
+    std::ofstream           output_;
+    Format                  format_;
+    int                     scale_;
+    int                     width_;
+    int                     height_;
+    std::vector<uint8_t>    pixels_;    // one scaled frame, one byte each
+    uint64_t                ticks_;     // frames written so far
+    std::thread             encoder_;   // started last
+};
+
+#endif
@@ -0,0 +1,71 @@
+//
+// CHIP-8 emulator
+//
+// By Jaldhar H. Vyas <jaldhar@braincells.com>
+// Copyright (C) 2021, Consolidated Braincells Inc.  All rights reserved.
+// "Do what thou wilt" shall be the whole of the license.
+//
+
+#ifndef ROM_H
+#define ROM_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include "vm.h"
+
+constexpr static std::size_t ROM_MAX_SIZE = MEM_SIZE - PROGRAM_START;
+
+// A ROM image, read once and kept so it can be copied into a VM as often as
+// needed.
+class Rom {
+public:
+    explicit Rom(const char* filename);
+    Rom(const uint8_t* data, std::size_t size);
+
+    const uint8_t*  data() const;
+    std::string     hash() const;
+    std::size_t     size() const;
+
+private:
+    using Image = std::array<uint8_t, ROM_MAX_SIZE>;
+
+    Image           image_;
+    std::size_t     size_;
+};
+
+// Per-ROM settings.  The fields follow the CHIP-8 community database
+// (https://github.com/chip-8/chip-8-database.)
+struct RomInfo {
+    std::string title{};
+    std::string platform{"originalChip8"};
+    int         tickrate = 0;           // instructions per frame; 0 = default
+    Quirks      quirks{};
+    std::string keys{};                 // keyboard keys for CHIP-8 keys 0-F
+};
+
+// An index of RomInfo keyed by the SHA-1 hash of the ROM.  The index file is
+// plain text with one ROM per line.  Fields are separated by tabs:
+//
+//  sha1    title   platform    tickrate    quirks  keys
+//
+// quirks is a comma-separated list of the quirks which are enabled.  Any field
+// after sha1 may be '-' or left out to use the default.  Lines starting with
+// '#' are comments.
+class RomLibrary {
+public:
+    explicit RomLibrary();
+
+    void            loadIndex(const char* filename);
+    const RomInfo*  lookup(const Rom&) const;
+    std::size_t     size() const;
+
+private:
+    std::unordered_map<std::string, RomInfo>    index_;
+};
+
+std::string sha1(const uint8_t* data, std::size_t size);
+
+#endif
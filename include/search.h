@@ -0,0 +1,77 @@
+//
+// CHIP-8 emulator
+//
+// By Jaldhar H. Vyas <jaldhar@braincells.com>
+// Copyright (C) 2021, Consolidated Braincells Inc.  All rights reserved.
+// "Do what thou wilt" shall be the whole of the license.
+//
+
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <vector>
+#include "pool.h"
+#include "vm.h"
+
+// Chooses inputs for a ROM by Monte Carlo tree search.  From a starting
+// state, each possible action (a set of keys held down for a number of
+// frames) is tried on a copy of the VM and the results are scored.  The
+// most promising sequences are explored further and random play is used to
+// estimate how good a state is.  Each thread searches its own tree and the
+// results are combined at the end.
+class Search {
+public:
+    // Higher is better.
+    using Scorer = std::function<double(const Chip8VM&)>;
+
+    struct Options {
+        std::vector<uint16_t>   actions{ 0 };   // key masks to choose from
+        int                     frames = 4;     // per action
+        int                     tickrate = 4;   // instructions per frame
+        int                     iterations = 1000;  // per thread
+        int                     depth = 10;     // actions per random playout
+        int                     threads = 0;    // 0 = one per CPU
+        double                  exploration = 1.4;
+        uint32_t                seed = 0;
+    };
+
+    struct Result {
+        uint16_t    action;     // the best action to take now
+        double      value;      // average score after taking it
+        int         visits;     // how many times it was explored
+    };
+
+    Search(const Options&, Scorer);
+
+    static void     advance(Chip8VM&, uint16_t keys, int frames,
+                        int tickrate);
+    Result          run(const Chip8VM&) const;
+    static Scorer   scoreDisplay(std::function<bool(const Chip8VM&)>);
+    static Scorer   scoreMemory(uint16_t address, int size);
+
+private:
+    struct Node {
+        Pool<Chip8VM>::Ptr          state;
+        std::vector<int>            children;   // by action; -1 if not tried
+        int                         visits;
+        double                      total;      // sum of backed up values
+        bool                        done;       // the VM faulted
+    };
+
+    struct Totals {
+        std::vector<int>    visits{};           // by action
+        std::vector<double> total{};
+    };
+
+    double  playout(const Chip8VM&, Chip8VM& scratch,
+                std::minstd_rand&) const;
+    Totals  searchTree(const Chip8VM&, uint32_t seed) const;
+
+    Options options_;
+    Scorer  scorer_;
+};
+
+#endif
@@ -0,0 +1,72 @@
+//
+// CHIP-8 emulator
+//
+// By Jaldhar H. Vyas <jaldhar@braincells.com>
+// Copyright (C) 2021, Consolidated Braincells Inc.  All rights reserved.
+// "Do what thou wilt" shall be the whole of the license.
+//
+
+#ifndef SPSC_H
+#define SPSC_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// A fixed-size lock-free queue for passing values from exactly one producer
+// thread to exactly one consumer thread.  N must be a power of 2.
+template<typename T, std::size_t N>
+class SPSCQueue {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "N must be a power of 2");
+
+public:
+    explicit SPSCQueue() : buffer_{}, head_{0}, tail_{0} {
+    }
+
+    SPSCQueue(const SPSCQueue&) = delete;
+    SPSCQueue& operator=(const SPSCQueue&) = delete;
+
+    // Producer.  Returns false if the queue is full.
+    bool push(const T& value) {
+        auto tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == N) {
+            return false;
+        }
+        buffer_[tail & (N - 1)] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer.  Returns false if the queue is empty.
+    bool peek(T& value) const {
+        auto head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = buffer_[head & (N - 1)];
+        return true;
+    }
+
+    // Consumer.  Returns false if the queue is empty.
+    bool pop(T& value) {
+        if (!peek(value)) {
+            return false;
+        }
+        head_.store(head_.load(std::memory_order_relaxed) + 1,
+            std::memory_order_release);
+        return true;
+    }
+
+    // Either thread; only approximate while the other thread is active.
+    std::size_t size() const {
+        return tail_.load(std::memory_order_acquire) -
+            head_.load(std::memory_order_acquire);
+    }
+
+private:
+    std::array<T, N>                    buffer_;
+    alignas(64) std::atomic<std::size_t> head_; // next to be read
+    alignas(64) std::atomic<std::size_t> tail_; // next to be written
+};
+
+#endif
@@ -0,0 +1,65 @@
+//
+// CHIP-8 emulator
+//
+// By Jaldhar H. Vyas <jaldhar@braincells.com>
+// Copyright (C) 2021, Consolidated Braincells Inc.  All rights reserved.
+// "Do what thou wilt" shall be the whole of the license.
+//
+
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <array>
+#include <atomic>
+
+// Passes the latest value from one thread to another without either of them
+// ever waiting.  The writer fills in back() and publishes it; the reader
+// calls update() and, if it returns true, reads front().  Values published
+// while the reader is busy replace each other so the reader only ever sees
+// the newest.
+template<typename T>
+class TripleBuffer {
+public:
+    explicit TripleBuffer() : buffers_{}, back_{0}, middle_{1}, front_{2} {
+    }
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // Writer.
+    T& back() {
+        return buffers_[back_];
+    }
+
+    // Writer.  back() is a different buffer afterwards.
+    void publish() {
+        back_ = middle_.exchange(back_ | FRESH, std::memory_order_acq_rel) &
+            INDEX;
+    }
+
+    // Reader.
+    const T& front() const {
+        return buffers_[front_];
+    }
+
+    // Reader.  Returns false if nothing has been published since the last
+    // call.
+    bool update() {
+        if (!(middle_.load(std::memory_order_relaxed) & FRESH)) {
+            return false;
+        }
+        front_ = middle_.exchange(front_, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+private:
+    constexpr static int INDEX = 0x3;
+    constexpr static int FRESH = 0x4;   // middle_ was published, not read
+
+    std::array<T, 3>    buffers_;
+    int                 back_;          // writer only
+    std::atomic<int>    middle_;        // index, plus FRESH
+    int                 front_;         // reader only
+};
+
+#endif
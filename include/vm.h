@@ -13,10 +13,16 @@
 #include <bitset>
 #include <cstdint>
 #include <functional>
+#include <memory>
 #include <random>
+#include "opcodes.h"
 
 constexpr static int MEM_SIZE =   0x1000;
+constexpr static int MEM_MASK =   MEM_SIZE - 1;
+constexpr static int PROGRAM_START = 0x0200;
 constexpr static int STACK_SIZE = 0x0010;
+constexpr static int STACK_MASK = STACK_SIZE - 1;
+constexpr static int CODE_GRANULE = 0x0040; // bytes per bit of the code map
 constexpr static int SCREEN_WIDTH  = 0x40;
 constexpr static int SCREEN_HEIGHT = 0x20;
 
@@ -39,24 +45,158 @@ enum class Command : uint8_t {
     KEY_F = 0xf,
 };
 
+// Faults are sticky bits which are set instead of accessing memory out of
+// bounds.  Addresses simply wrap around so execution can continue but the
+// program is probably not doing what it was meant to.
+constexpr static uint8_t FAULT_STACK_OVERFLOW =  0x01;
+constexpr static uint8_t FAULT_STACK_UNDERFLOW = 0x02;
+
 enum class KBState : uint8_t {
     UNBLOCKED = 0,
     RELEASING = 1,
     BLOCKED   = 2
 };
 
+// Behaviors which differ between CHIP-8 implementations.  The defaults match
+// the original COSMAC VIP interpreter.
+struct Quirks {
+    bool logic = true;                  // 8XY1-8XY3 reset VF
+    bool shift = false;                 // 8XY6/8XYE shift VX instead of VY
+    bool memoryLeaveIUnchanged = false; // FX55/FX65 do not advance I
+    bool jump = false;                  // BNNN jumps to XNN + VX
+    bool wrap = false;                  // sprites wrap instead of clipping
+};
+
+// Memory which is divided into pages so that copies of a VM can share what
+// neither of them has written to.  Until a page is written, it is read from
+// an image which is shared by every copy; the first write copies it into
+// the object.  Copying only copies the pages which have been written, which
+// for most ROMs are the one or two where they keep their variables, instead
+// of all of memory.
+class PagedMemory {
+public:
+    using Image = std::array<uint8_t, MEM_SIZE>;
+
+    constexpr static int PAGE_SIZE = 0x100;
+    constexpr static int PAGE_COUNT = MEM_SIZE / PAGE_SIZE;
+
+    explicit PagedMemory(std::shared_ptr<const Image>);
+    PagedMemory(const PagedMemory&);
+    PagedMemory& operator=(const PagedMemory&);
+
+    uint8_t operator[](uint16_t address) const {
+        address &= MEM_MASK;
+        return pages_[address / PAGE_SIZE][address % PAGE_SIZE];
+    }
+
+    // Big-endian, as instructions are stored.
+    uint16_t word(uint16_t address) const {
+        address &= MEM_MASK;
+        auto offset = address % PAGE_SIZE;
+        if (offset == PAGE_SIZE - 1) {
+            return ((*this)[address] << 8) | (*this)[address + 1];
+        }
+        const uint8_t* bytes = pages_[address / PAGE_SIZE] + offset;
+        return (bytes[0] << 8) | bytes[1];
+    }
+
+    int         dirtyPages() const;
+    const std::shared_ptr<const Image>& image() const;
+    void        reset(std::shared_ptr<const Image>);
+
+    void write(uint16_t address, uint8_t value) {
+        address &= MEM_MASK;
+        auto page = address / PAGE_SIZE;
+        if (!((dirty_ >> page) & 1)) {
+            copyPage(page);
+        }
+        own_[page].bytes[address % PAGE_SIZE] = value;
+    }
+
+private:
+    struct Page {
+        Page() {    // left uninitialized until the page is copied
+        }
+
+        uint8_t bytes[PAGE_SIZE];
+    };
+
+    void        copyPage(int);
+
+    std::array<const uint8_t*, PAGE_COUNT>  pages_; // each in image_ or own_
+    uint16_t                                dirty_; // bit n: page n is in own_
+    std::shared_ptr<const Image>            image_;
+    std::array<Page, PAGE_COUNT>            own_;
+};
+
+// Memory as one array.  Copies are always of all of it, but reads and writes
+// go straight to it, which is better for a build that only ever runs one VM.
+// Define FLAT_MEMORY to use it instead of PagedMemory.
+class FlatMemory {
+public:
+    using Image = std::array<uint8_t, MEM_SIZE>;
+
+    explicit FlatMemory(std::shared_ptr<const Image>);
+
+    uint8_t operator[](uint16_t address) const {
+        return bytes_[address & MEM_MASK];
+    }
+
+    // Big-endian, as instructions are stored.
+    uint16_t word(uint16_t address) const {
+        return (bytes_[address & MEM_MASK] << 8) |
+            bytes_[(address + 1) & MEM_MASK];
+    }
+
+    const std::shared_ptr<const Image>& image() const;
+    void        reset(std::shared_ptr<const Image>);
+
+    void write(uint16_t address, uint8_t value) {
+        bytes_[address & MEM_MASK] = value;
+    }
+
+private:
+    Image                                   bytes_;
+    std::shared_ptr<const Image>            image_;
+};
+
+struct CompiledBlock;
+struct CompiledRom;
+class Rom;
+
 class Chip8VM {
 public:
+    // Called with the cycle count whenever the sound starts or stops.
+    using SoundListener = std::function<void(uint64_t cycle, bool on)>;
+
     explicit Chip8VM();
 
     void  cycle();
+    uint64_t cycles() const;
+    uint64_t displayHash() const;
+    uint64_t displayRow(int) const;
+    uint8_t faults() const;
     void  handleInterrupts();
+    bool  idle() const;
     void  input(Command, bool);
     bool  isBeeping();
     void  load(const char* filename);
+    void  load(const Rom&);
+    uint8_t memoryAt(uint16_t) const;
+    void  onSound(SoundListener);
     bool  pixelAt(int, int) const;
+    void  reset(bool hard = false);
+    void  run(uint64_t count);
+    void  seed(uint32_t);
+    void  setCompiled(const CompiledRom*);
+    void  setKeys(uint16_t);
+    void  setQuirks(const Quirks&);
+    uint64_t skipped() const;
 
 private:
+    friend class Debugger;
+    friend class Runtime;
+
     struct OneArg {
         uint16_t NNN_:12;
     };
@@ -81,14 +221,13 @@ private:
         } args_;
     };
 
+    void                execute();
+    int                 idleLoop() const;
+    void                invalidate(uint16_t address, int length);
+    void                written(uint16_t address, int length);
     const Instruction   fetch();
     void                decode(const Instruction&);
 
-    void                table0(const Instruction&);
-    void                table8(const Instruction&);
-    void                tableE(const Instruction&);
-    void                tableF(const Instruction&);
-
     void                no_op(const Instruction&);
     void                cls(const Instruction&);
     void                ret(const Instruction&);
@@ -126,32 +265,97 @@ private:
     void                load_reg(const Instruction&);
 
     using Registers = std::array<uint8_t, 16>;
-    using Memory = std::array<uint8_t, MEM_SIZE>;
+#ifdef FLAT_MEMORY
+    using Memory = FlatMemory;
+#else
+    using Memory = PagedMemory;
+#endif
     using Stack = std::array<uint16_t, STACK_SIZE>;
     using Display = std::array<std::bitset<SCREEN_WIDTH>, SCREEN_HEIGHT>;
-    using Keys = std::bitset<16>;
-    using Opcode = std::function<void(Chip8VM*, const Instruction&)>;
+    using Keys = uint16_t;                  // bit n is set if key n is down
+    using Handler = void (Chip8VM::*)(const Instruction&);
+    using Blocks = std::array<const CompiledBlock*, MEM_SIZE>;
 
-    Registers                           V_;     // general-purpose registers
+    static const std::array<Handler, OP_COUNT> HANDLERS;
+
+    // Everything an instruction normally touches is at the start, in one
+    // cache line, followed by the rest of the machine state in order of how
+    // often it is used.  Things which are rarely used or shared between VMs
+    // are last.  This keeps as much as possible of many VMs in the cache at
+    // once and makes copies cheap.  The constructor checks that everything
+    // before displayHash_ still fits in the first line.
+    alignas(64) Registers               V_;     // general-purpose registers
     uint16_t                            I_;     // memory address register
     uint16_t                            PC_;    // program counter register
     uint8_t                             SP_;    // stack pointer register
     uint8_t                             DT_;    // delay timer register
     uint8_t                             ST_;    // sound timer register
+    uint8_t                             faults_;
+    KBState                             kbstate_;
+    Quirks                              quirks_;
+    Keys                                keys_;
+    uint64_t                            cycles_; // instructions executed
+    uint64_t                            codeMap_; // granules with compiled code
+    std::shared_ptr<const Blocks>       compiled_; // by address, or null
 
-    Memory                              memory_;
+    uint64_t                            displayHash_;
     Stack                               stack_;
     Display                             display_;
-    Keys                                keys_;
+    Memory                              memory_;
+
     std::minstd_rand                    rnd_;
     std::uniform_int_distribution<unsigned short> d_;
-    KBState                             kbstate_;
+    std::shared_ptr<const Blocks>       compiledImage_; // as of setCompiled()
+    uint64_t                            skipped_; // cycles run() skipped
+    SoundListener                       soundListener_;
+
+#ifdef DEBUG
+    // Only the debug build checks for breakpoints.  When cycle() reaches
+    // one it sets halted_ and returns without executing anything.
+    std::bitset<MEM_SIZE>               breakpoints_{};
+    bool                                halted_ = false;
+#endif
+};
 
-    std::array<Opcode, 16>              optable_;
-    std::array<Opcode, 16>              optable0_;
-    std::array<Opcode, 16>              optable8_;
-    std::array<Opcode, 16>              optableE_;
-    std::array<Opcode, 256>             optableF_;
+// Indexed by Op so the VM decodes instructions exactly as the disassembler
+// does.  It is defined here so that compiled code, which calls it with
+// constant instructions, can call the handlers directly.
+inline constexpr std::array<Chip8VM::Handler, OP_COUNT> Chip8VM::HANDLERS {
+    &Chip8VM::no_op,
+    &Chip8VM::cls,
+    &Chip8VM::ret,
+    &Chip8VM::jmp,
+    &Chip8VM::call,
+    &Chip8VM::skip_if_eq_c,
+    &Chip8VM::skip_if_neq_c,
+    &Chip8VM::skip_if_eq_r,
+    &Chip8VM::move_c,
+    &Chip8VM::add_c,
+    &Chip8VM::move_r,
+    &Chip8VM::bitwise_or,
+    &Chip8VM::bitwise_and,
+    &Chip8VM::bitwise_xor,
+    &Chip8VM::add_r,
+    &Chip8VM::sub_r,
+    &Chip8VM::shift_right,
+    &Chip8VM::sub_n,
+    &Chip8VM::shift_left,
+    &Chip8VM::skip_if_neq_r,
+    &Chip8VM::load_i,
+    &Chip8VM::jmp_v0,
+    &Chip8VM::rand,
+    &Chip8VM::draw,
+    &Chip8VM::skip_if_key,
+    &Chip8VM::skip_if_nkey,
+    &Chip8VM::save_delay,
+    &Chip8VM::wait_key,
+    &Chip8VM::load_delay,
+    &Chip8VM::load_sound,
+    &Chip8VM::add_i,
+    &Chip8VM::font,
+    &Chip8VM::bcd,
+    &Chip8VM::save_reg,
+    &Chip8VM::load_reg
 };
 
 #endif
\ No newline at end of file
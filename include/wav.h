@@ -0,0 +1,35 @@
+//
+// CHIP-8 emulator
+//
+// By Jaldhar H. Vyas <jaldhar@braincells.com>
+// Copyright (C) 2021, Consolidated Braincells Inc.  All rights reserved.
+// "Do what thou wilt" shall be the whole of the license.
+//
+
+#ifndef WAV_H
+#define WAV_H
+
+#include <cstdint>
+#include <fstream>
+
+// Writes mono 16-bit PCM .WAV files a sample at a time.  The header is filled
+// in by close() (or the destructor.)
+class WavWriter {
+public:
+    explicit WavWriter(const char* filename, uint32_t sampleRate);
+    ~WavWriter();
+    WavWriter(const WavWriter&) = delete;
+    WavWriter& operator=(const WavWriter&) = delete;
+
+    void    close();
+    void    write(float sample);
+
+private:
+    void    writeHeader();
+
+    std::ofstream   output_;
+    uint32_t        sampleRate_;
+    uint32_t        samples_;
+};
+
+#endif
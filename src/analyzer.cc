@@ -0,0 +1,260 @@
+//
+// CHIP-8 emulator
+//
+// By Jaldhar H. Vyas <jaldhar@braincells.com>
+// Copyright (C) 2021, Consolidated Braincells Inc.  All rights reserved.
+// "Do what thou wilt" shall be the whole of the license.
+//
+
+#include <algorithm>
+#include "analyzer.h"
+#include "rom.h"
+
+Analyzer::Analyzer(const Rom& rom, const Quirks& quirks) : image_{},
+end_{static_cast<uint16_t>(PROGRAM_START + rom.size())}, quirks_{quirks},
+kinds_{}, instructions_{}, leaders_{}, writes_{}, blocks_{}, notes_{},
+indirect_{false}, selfModifying_{false} {
+    std::copy_n(rom.data(), rom.size(), &image_[PROGRAM_START]);
+    kinds_.fill(Kind::UNKNOWN);
+
+    if (end_ >= PROGRAM_START + 2) {
+        std::vector<uint16_t> pending{ PROGRAM_START };
+        leaders_.set(PROGRAM_START);
+        while (!pending.empty()) {
+            auto entry = pending.back();
+            pending.pop_back();
+            trace(entry, pending);
+        }
+    }
+
+    checkWrites();
+    findBlocks();
+
+    std::stable_sort(notes_.begin(), notes_.end(),
+        [](const Note& a, const Note& b) { return a.address < b.address; });
+}
+
+const std::vector<Analyzer::Block>& Analyzer::blocks() const {
+    return blocks_;
+}
+
+uint8_t Analyzer::byteAt(uint16_t address) const {
+    return image_[address & MEM_MASK];
+}
+
+uint16_t Analyzer::end() const {
+    return end_;
+}
+
+bool Analyzer::hasIndirectJumps() const {
+    return indirect_;
+}
+
+bool Analyzer::hasSelfModifyingCode() const {
+    return selfModifying_;
+}
+
+bool Analyzer::isInstruction(uint16_t address) const {
+    return instructions_.test(address & MEM_MASK);
+}
+
+bool Analyzer::isLeader(uint16_t address) const {
+    return leaders_.test(address & MEM_MASK);
+}
+
+Analyzer::Kind Analyzer::kindAt(uint16_t address) const {
+    return kinds_[address & MEM_MASK];
+}
+
+const std::vector<Analyzer::Note>& Analyzer::notes() const {
+    return notes_;
+}
+
+uint16_t Analyzer::wordAt(uint16_t address) const {
+    return (image_[address & MEM_MASK] << 8) | image_[(address + 1) & MEM_MASK];
+}
+
+// Code found by trace() wins over data so a write is only flagged once all
+// the code is known.
+void Analyzer::checkWrites() {
+    for (const auto& write : writes_) {
+        for (auto i = 0; i < write.length; i++) {
+            auto address = (write.address + i) & MEM_MASK;
+            if (kinds_[address] == Kind::CODE) {
+                note(write.from, "overwrites code at " + hex(address, 3));
+                selfModifying_ = true;
+                break;
+            }
+        }
+        mark(write.address, write.length, Kind::DATA);
+    }
+}
+
+void Analyzer::findBlocks() {
+    for (uint16_t start = PROGRAM_START; start < end_; start++) {
+        if (!instructions_.test(start) || !leaders_.test(start)) {
+            continue;
+        }
+
+        uint16_t pc = start;
+        uint16_t word;
+        Flow flow;
+        do {
+            word = wordAt(pc);
+            flow = opInfo(decodeOp(word)).flow;
+            pc += 2;
+        } while (flow == Flow::NEXT && instructions_.test(pc) &&
+        !leaders_.test(pc));
+
+        Block block{ start, pc, flow, {} };
+        switch (flow) {
+            case Flow::NEXT:
+                if (instructions_.test(pc)) {
+                    block.successors.push_back(pc);
+                }
+                break;
+            case Flow::SKIP:
+                block.successors.push_back(pc);
+                block.successors.push_back(pc + 2);
+                break;
+            case Flow::JUMP:
+                block.successors.push_back(word & 0x0FFF);
+                break;
+            case Flow::CALL:
+                block.successors.push_back(word & 0x0FFF);
+                block.successors.push_back(pc);
+                break;
+            case Flow::RETURN:
+            case Flow::INDIRECT:
+                break;
+        }
+        blocks_.push_back(block);
+    }
+}
+
+// Code is never downgraded to data.
+void Analyzer::mark(uint16_t address, int length, Kind kind) {
+    for (auto i = 0; i < length; i++) {
+        auto& current = kinds_[(address + i) & MEM_MASK];
+        if (current != Kind::CODE) {
+            current = kind;
+        }
+    }
+}
+
+void Analyzer::note(uint16_t address, const std::string& text) {
+    notes_.push_back(Note{ address, text });
+}
+
+// Follows one path of execution from entry until it ends or reaches code
+// which has already been traced.  Other paths are added to pending.  What I
+// points to is only known from an ANNN until the next call or the end of the
+// path.
+void Analyzer::trace(uint16_t entry, std::vector<uint16_t>& pending) {
+    bool knownI = false;
+    uint16_t I = 0;
+
+    auto follow = [this, &pending](uint16_t from, uint16_t target) {
+        if (target < PROGRAM_START || target + 1 >= end_) {
+            note(from, "goes to " + hex(target, 3) + " outside the program");
+            return;
+        }
+        leaders_.set(target);
+        pending.push_back(target);
+    };
+
+    for (uint16_t pc = entry; ; pc += 2) {
+        if (pc + 1 >= end_) {
+            note(pc, "runs off the end of the program");
+            return;
+        }
+        if (instructions_.test(pc)) {
+            return;
+        }
+        if (kinds_[pc] == Kind::DATA) {
+            note(pc, "runs into data");
+            return;
+        }
+        if (kinds_[pc] == Kind::CODE || kinds_[pc + 1] == Kind::CODE) {
+            note(pc, "overlaps another instruction");
+        }
+        instructions_.set(pc);
+        mark(pc, 2, Kind::CODE);
+
+        auto word = wordAt(pc);
+        auto op = decodeOp(word);
+        auto x = (word >> 8) & 0x000F;
+        uint16_t nnn = word & 0x0FFF;
+
+        switch (op) {
+            case Op::NO_OP:
+                note(pc, hex(word, 4) + " is ignored");
+                break;
+            case Op::LOAD_I:
+                I = nnn;
+                knownI = true;
+                break;
+            case Op::ADD_I:
+            case Op::FONT:
+                knownI = false;
+                break;
+            // Execution carries on after the key is pressed so that is
+            // where the next block starts.
+            case Op::WAIT_KEY:
+                leaders_.set(pc + 2);
+                break;
+            case Op::DRAW:
+                if (knownI) {
+                    mark(I, word & 0x000F, Kind::DATA);
+                }
+                break;
+            case Op::BCD:
+            case Op::SAVE_REG:
+            case Op::LOAD_REG: {
+                auto length = (op == Op::BCD) ? 3 : x + 1;
+                if (!knownI) {
+                    if (op != Op::LOAD_REG) {
+                        note(pc, "writes through an unknown I");
+                    }
+                    break;
+                }
+                if (op == Op::LOAD_REG) {
+                    mark(I, length, Kind::DATA);
+                } else {
+                    writes_.push_back(Write{ pc, I, length });
+                }
+                if (op != Op::BCD && !quirks_.memoryLeaveIUnchanged) {
+                    I += length;
+                }
+                break;
+            }
+            default:
+                break;
+        }
+
+        switch (opInfo(op).flow) {
+            case Flow::NEXT:
+                break;
+            case Flow::SKIP:
+                leaders_.set(pc + 2);
+                follow(pc, pc + 4);
+                break;
+            case Flow::JUMP:
+                follow(pc, nnn);
+                return;
+            case Flow::CALL:
+                leaders_.set(pc + 2);
+                follow(pc, nnn);
+                knownI = false;
+                break;
+            case Flow::RETURN:
+                return;
+            case Flow::INDIRECT:
+                note(pc, quirks_.jump ?
+                    "jumps to " + hex(nnn, 3) + " + V" + hex(x, 1) :
+                    "jumps to " + hex(nnn, 3) + " + V0");
+                indirect_ = true;
+                return;
+        }
+    }
+}
@@ -0,0 +1,111 @@
+//
+// CHIP-8 emulator
+//
+// By Jaldhar H. Vyas <jaldhar@braincells.com>
+// Copyright (C) 2021, Consolidated Braincells Inc.  All rights reserved.
+// "Do what thou wilt" shall be the whole of the license.
+//
+
+#include <algorithm>
+#include <cmath>
+#include "beeper.h"
+
+constexpr static double TAU = 2.0 * 3.14159265358979323846;
+constexpr static float VOLUME = 0.5f;
+constexpr static float RAMP_TIME = 0.002f;        // seconds to fade in or out
+constexpr static double TARGET_LATENCY = 0.05;    // seconds behind emulation
+constexpr static double MAX_LATENCY = 0.25;       // jump ahead past this
+constexpr static double MAX_CORRECTION = 0.005;   // largest change in rate
+constexpr static double SMOOTHING = 0.0005;       // weight of each new lag
+
+Beeper::Beeper(uint32_t sampleRate, float frequency, double cyclesPerSecond) :
+events_{}, now_{0}, cyclesPerSecond_{cyclesPerSecond}, speed_{1.0},
+latency_{0.0}, sampleRate_{sampleRate}, cursor_{0.0}, lag_{0.0}, on_{false},
+phase_{0.0}, step_{frequency / static_cast<double>(sampleRate)},
+level_{0.0f}, ramp_{1.0f / (RAMP_TIME * sampleRate)} {
+}
+
+void Beeper::advance(uint64_t cycle) {
+    now_.store(cycle, std::memory_order_release);
+}
+
+bool Beeper::push(uint64_t cycle, bool on) {
+    return events_.push(Event{ cycle, on });
+}
+
+void Beeper::setCycleRate(double cyclesPerSecond) {
+    cyclesPerSecond_.store(cyclesPerSecond, std::memory_order_relaxed);
+}
+
+void Beeper::setSpeed(double speed) {
+    speed_.store(speed, std::memory_order_relaxed);
+}
+
+double Beeper::latency() const {
+    return latency_.load(std::memory_order_relaxed);
+}
+
+// Move the cursor one sample along the emulation timeline and apply any
+// edges it passes.
+void Beeper::follow() {
+    double now = static_cast<double>(now_.load(std::memory_order_acquire));
+    double cyclesPerSample = cyclesPerSecond_.load(std::memory_order_relaxed) *
+        speed_.load(std::memory_order_relaxed) / sampleRate_;
+    double target = TARGET_LATENCY * cyclesPerSample * sampleRate_;
+
+    lag_ += ((now - cursor_) - lag_) * SMOOTHING;
+
+    if (now - cursor_ > target * (MAX_LATENCY / TARGET_LATENCY)) {
+        // Too far behind (e.g. at startup or after a stall) to catch up
+        // smoothly.
+        cursor_ = now - target;
+        lag_ = target;
+    } else {
+        double correction = std::clamp((lag_ - target) / target,
+            -1.0, 1.0) * MAX_CORRECTION;
+        cursor_ = std::min(cursor_ + cyclesPerSample * (1.0 + correction),
+            now);
+    }
+
+    applyEvents();
+
+    latency_.store(lag_ / (cyclesPerSample * sampleRate_),
+        std::memory_order_relaxed);
+}
+
+void Beeper::applyEvents() {
+    Event event;
+    while (events_.peek(event) && event.cycle <= cursor_) {
+        on_ = event.on;
+        events_.pop(event);
+    }
+}
+
+float Beeper::sample() {
+    follow();
+    return tone();
+}
+
+float Beeper::sampleAt(double cycle) {
+    cursor_ = cycle;
+    applyEvents();
+    return tone();
+}
+
+// The phase carries on from one sample to the next whether or not the tone
+// is sounding and the amplitude is ramped rather than switched so there are
+// no clicks when the tone starts or stops.
+float Beeper::tone() {
+    if (on_) {
+        level_ = std::fmin(level_ + ramp_, 1.0f);
+    } else {
+        level_ = std::fmax(level_ - ramp_, 0.0f);
+    }
+
+    phase_ += step_;
+    if (phase_ >= 1.0) {
+        phase_ -= 1.0;
+    }
+
+    return VOLUME * level_ * static_cast<float>(std::sin(TAU * phase_));
+}
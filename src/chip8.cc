@@ -6,12 +6,20 @@
 // "Do what thou wilt" shall be the whole of the license.
 //
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
 #include <chrono>
 #include <clocale>
 #include <csignal>
 #include <cstdlib>
+#include <cstring>
+#include <iomanip>
 #include <iostream>
-#include <map>
+#include <memory>
+#include <sstream>
+#include <thread>
 
 #define OLC_PGE_APPLICATION
 #include "olcPixelGameEngine.h"
@@ -19,15 +27,26 @@
 #define OLC_SOUNDWAVE
 #include "olcSoundWaveEngine.h"
 
+#include "beeper.h"
+#include "debugger.h"
+#include "emulator.h"
+#include "filter.h"
+#include "recorder.h"
+#include "rom.h"
 #include "vm.h"
 
 constexpr static int SCALE = 8;
 constexpr static float INTERRUPT_TICK = 1.0f / 60.0f;
 constexpr static float CPU_TICK = 1.0f / 240.0f;
+constexpr static double FAST_FORWARD = 4.0;    // speed while Tab is held
+// How long to wait when the emulator hasn't finished a new frame yet.
+constexpr static std::chrono::milliseconds FRAME_WAIT{1};
 constexpr static std::size_t SAMPLE_RATE = 44100;
-constexpr static std::size_t SAMPLES = SAMPLE_RATE / 60;
 constexpr static float FREQUENCY = 440.0f;
-constexpr static float TAU = 2.0f * 3.14159f;
+constexpr static float STATS_INTERVAL = 0.5f;
+
+static_assert(sizeof(olc::Pixel) == sizeof(uint32_t),
+    "filters write pixels as uint32_t");
 
 volatile bool endflag = false;
 
@@ -53,64 +72,199 @@ class View : public olc::PixelGameEngine
 public:
     View(Chip8VM&);
     ~View()=default;
+    View(const View&)=delete;
+    View& operator=(const View&)=delete;
+
+    void attach(Debugger*);
+    void configure(const RomInfo&);
+    void record(Recorder*);
+    void setBlend(bool);
+    void setFilter(Filter::Type);
+    void showOverlay(bool);
 
     bool OnUserCreate() override;
     bool OnUserDestroy() override;
     bool OnUserUpdate(float) override;
 
 private:
-    void draw();
+    using Clock = std::chrono::steady_clock;
+    using Keymap = std::array<olc::Key, 16>;   // indexed by CHIP-8 key
+
+    // Performance figures for the overlay.  Times are accumulated over
+    // STATS_INTERVAL and then averaged per host frame.
+    struct Stats {
+        Clock::duration         vm{};
+        Clock::duration         draw{};
+        std::atomic<int64_t>    audio{0};   // nanoseconds; audio thread
+        float                   elapsed = 0.0f;
+        int                     frames = 0;
+        uint64_t                cycles = 0; // vm_.cycles() at start
+        bool                    keyPending = false;
+        Clock::time_point       keyTime{};  // when a key was pressed
+        float                   keyLatency = 0.0f;
+        std::string             text{};
+    };
+
+    void draw(float elapsed);
+    void drawOverlay(float elapsed);
+    void drawStatus();
+    void handleDebugger();
     void handleInput();
+    void step(float elapsed);
 
-    using Keymap = std::map<Command, const olc::Key>;
-
+    float cpuTick_;
     float cpuLag_;
     float interruptLag_;
     Keymap keys_;
+    uint16_t keyState_;
 
     Chip8VM& vm_;
+    Debugger* debugger_;
+    Recorder* recorder_;
+
+    std::unique_ptr<olc::Sprite> screen_;
+    std::unique_ptr<olc::Decal> decal_;
+    Filter filter_;
+    Filter::Rows frame_;        // the display at the last vblank
+    Latch latch_;
 
-	olc::sound::WaveEngine soundengine_;
-	olc::sound::Wave beep_;
+    std::atomic<bool> overlay_;
+    Stats stats_;
 
+    Beeper beeper_;
+    olc::sound::WaveEngine soundengine_;
+
+    std::unique_ptr<Emulator> emulator_;    // stopped before beeper_ goes
 };
 
-View::View(Chip8VM& vm) : cpuLag_{ 0.0f }, interruptLag_ { 0.0f }, keys_{
-        { Command::KEY_0, olc::Key::X },
-        { Command::KEY_1, olc::Key::K1 },
-        { Command::KEY_2, olc::Key::K2 },
-        { Command::KEY_3, olc::Key::K3 },
-        { Command::KEY_4, olc::Key::Q },
-        { Command::KEY_5, olc::Key::W },
-        { Command::KEY_6, olc::Key::E },
-        { Command::KEY_7, olc::Key::A },
-        { Command::KEY_8, olc::Key::S },
-        { Command::KEY_9, olc::Key::D },
-        { Command::KEY_A, olc::Key::Z },
-        { Command::KEY_B, olc::Key::C },
-        { Command::KEY_C, olc::Key::K4 },
-        { Command::KEY_D, olc::Key::R },
-        { Command::KEY_E, olc::Key::F },
-        { Command::KEY_F, olc::Key::V },
-    }, vm_{vm}, soundengine_{}, beep_{} {
+View::View(Chip8VM& vm) : cpuTick_{ CPU_TICK }, cpuLag_{ 0.0f },
+    interruptLag_ { 0.0f }, keys_{
+        olc::Key::X,    // 0
+        olc::Key::K1,   // 1
+        olc::Key::K2,   // 2
+        olc::Key::K3,   // 3
+        olc::Key::Q,    // 4
+        olc::Key::W,    // 5
+        olc::Key::E,    // 6
+        olc::Key::A,    // 7
+        olc::Key::S,    // 8
+        olc::Key::D,    // 9
+        olc::Key::Z,    // A
+        olc::Key::C,    // B
+        olc::Key::K4,   // C
+        olc::Key::R,    // D
+        olc::Key::F,    // E
+        olc::Key::V,    // F
+    }, keyState_{0}, vm_{vm}, debugger_{nullptr}, recorder_{nullptr},
+    screen_{}, decal_{}, filter_{}, frame_{}, latch_{}, overlay_{false},
+    stats_{}, beeper_{SAMPLE_RATE, FREQUENCY, 1.0 / CPU_TICK},
+    soundengine_{}, emulator_{} {
     sAppName = "CHIP-8";
+
+    // If the queue is full the audio thread has stalled; dropping an edge is
+    // the least bad thing to do.
+    vm_.onSound([this](uint64_t cycle, bool on) {
+        beeper_.push(cycle, on);
+    });
+}
+
+// Only letters and digits can be mapped.
+static bool toKey(char c, olc::Key& key) {
+    c = std::tolower(static_cast<unsigned char>(c));
+
+    if (c >= 'a' && c <= 'z') {
+        key = static_cast<olc::Key>(olc::Key::A + (c - 'a'));
+        return true;
+    } else if (c >= '0' && c <= '9') {
+        key = static_cast<olc::Key>(olc::Key::K0 + (c - '0'));
+        return true;
+    }
+
+    return false;
+}
+
+// When a debugger is attached the VM is run through it.
+void View::attach(Debugger* debugger) {
+    debugger_ = debugger;
+}
+
+// Every 60Hz frame is recorded, whether or not the host showed it.
+void View::record(Recorder* recorder) {
+    recorder_ = recorder;
+}
+
+// Must be called before the window is created.
+void View::setBlend(bool blend) {
+    latch_.setBlend(blend);
+}
+
+// Must be called before the window is created.
+void View::setFilter(Filter::Type type) {
+    filter_ = Filter(type);
+}
+
+void View::showOverlay(bool overlay) {
+    overlay_ = overlay;
+}
+
+void View::configure(const RomInfo& info) {
+    if (!info.title.empty()) {
+        sAppName = "CHIP-8 - " + info.title;
+    }
+
+    if (info.tickrate > 0) {
+        cpuTick_ = INTERRUPT_TICK / info.tickrate;
+        beeper_.setCycleRate(1.0 / cpuTick_);
+    }
+
+    for (std::size_t i = 0; i < info.keys.size() && i < keys_.size(); i++) {
+        olc::Key key;
+        if (toKey(info.keys[i], key)) {
+            keys_[i] = key;
+        }
+    }
 }
 
 bool View::OnUserCreate() {
-    soundengine_.InitialiseAudio(SAMPLE_RATE, 1);
+    // The VM display is rendered into this sprite by the filter and
+    // uploaded to the GPU which does the rest of the scaling.
+    screen_ = std::make_unique<olc::Sprite>(filter_.width(), filter_.height());
+    decal_ = std::make_unique<olc::Decal>(screen_.get());
+
+    // The tone is synthesized continuously on the audio thread.  Timing it
+    // costs two clock reads per sample so it is only done for the overlay.
+    soundengine_.SetCallBack_SynthFunction([this](uint32_t, double) {
+        if (!overlay_) {
+            return beeper_.sample();
+        }
 
-    beep_ = olc::sound::Wave(1, sizeof(uint8_t), SAMPLE_RATE, SAMPLES);
+        auto start = Clock::now();
+        auto sample = beeper_.sample();
+        stats_.audio += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now() - start).count();
+        return sample;
+    });
+    soundengine_.InitialiseAudio(SAMPLE_RATE, 1);
 
-    double dt = 1.0 / SAMPLE_RATE;
-    for (size_t i = 0; i < SAMPLES; i++) {
-        double t = double(i) * dt;
-        beep_.file.data()[i] = float(0.5 * sin(TAU * FREQUENCY * t));
+    // Without a debugger the VM runs on a thread of its own so it keeps
+    // time whatever this one is doing.  The debugger has to be able to stop
+    // it between any two instructions so then it is run from here.
+    if (!debugger_) {
+        emulator_ = std::make_unique<Emulator>(vm_, beeper_,
+            std::lround(INTERRUPT_TICK / cpuTick_));
+        emulator_->setBlend(latch_.blend());
+        emulator_->setRecorder(recorder_);
+        emulator_->start();
     }
 
     return true;
 }
 
 bool View::OnUserDestroy() {
+    emulator_.reset();
+    soundengine_.DestroyAudio();
+    decal_.reset();
+    screen_.reset();
 
     return true;
 }
@@ -120,48 +274,207 @@ bool View::OnUserUpdate(float elapsed) {
         return false;
     }
 
-    // fixed time step
+    if (GetKey(olc::Key::F1).bPressed) {
+        overlay_ = !overlay_;
+    }
+
+    if (emulator_) {
+        auto tab = GetKey(olc::Key::TAB);
+        emulator_->setSpeed((tab.bPressed || tab.bHeld) ? FAST_FORWARD : 1.0);
+    }
+
+    handleInput();
+
+    if (debugger_) {
+        handleDebugger();
+    }
+
+    auto vmStart = Clock::now();
+    uint8_t faults;
+    bool fresh = true;
+
+    if (emulator_) {
+        fresh = emulator_->frame(frame_);
+        faults = emulator_->faults();
+    } else {
+        step(elapsed);
+        faults = vm_.faults();
+    }
+
+    if (faults) {
+        std::cerr << ((faults & FAULT_STACK_OVERFLOW) ?
+            "Stack overflow\n" : "Stack underflow\n");
+        return false;
+    }
+
+    auto drawStart = Clock::now();
+    draw(elapsed);
+    auto drawEnd = Clock::now();
+    Clock::duration vmTime = emulator_ ? emulator_->busy() :
+        drawStart - vmStart;
+
+    if (overlay_) {
+        stats_.vm += vmTime;
+        stats_.draw += drawEnd - drawStart;
+        drawOverlay(elapsed);
+    }
+
+    if (debugger_ && debugger_->paused()) {
+        drawStatus();
+    }
+
+    // Nothing has changed so give the host CPU a rest instead of drawing
+    // the same frame again straight away.  Keys are still read every
+    // millisecond or so.
+    if (!fresh) {
+        std::this_thread::sleep_for(FRAME_WAIT);
+    }
+
+    return true;
+}
+
+// The texture is only rewritten when the filtered image has changed, so at
+// most once per frame.
+void View::draw(float elapsed) {
+    if (filter_.apply(frame_, elapsed / INTERRUPT_TICK,
+    reinterpret_cast<uint32_t*>(screen_->GetData()))) {
+        decal_->Update();
+
+        // Key latency is measured up to the first frame which shows a
+        // change after the key was pressed.
+        if (stats_.keyPending) {
+            stats_.keyLatency = std::chrono::duration<float, std::milli>(
+                Clock::now() - stats_.keyTime).count();
+            stats_.keyPending = false;
+        }
+    }
+
+    DrawDecal({ 0.0f, 0.0f }, decal_.get(),
+        { 1.0f / filter_.scaleX(), 1.0f / filter_.scaleY() });
+}
+
+void View::drawOverlay(float elapsed) {
+    stats_.elapsed += elapsed;
+    stats_.frames++;
+
+    if (stats_.elapsed >= STATS_INTERVAL) {
+        using ms = std::chrono::duration<float, std::milli>;
+        auto cycles = emulator_ ? emulator_->cycles() : vm_.cycles();
+        auto frames = static_cast<float>(stats_.frames);
+        std::ostringstream text;
+
+        text << std::fixed << std::setprecision(1)
+            << "IPS   " << static_cast<long>((cycles - stats_.cycles) /
+                stats_.elapsed) << '\n'
+            << "frame " << stats_.elapsed * 1000.0f / frames << "ms\n"
+            << "vm    " << ms(stats_.vm).count() / frames << "ms\n"
+            << "draw  " << ms(stats_.draw).count() / frames << "ms\n"
+            << "audio " << stats_.audio.exchange(0) / 1.0e6f / frames
+                << "ms\n"
+            << "lag   " << beeper_.latency() * 1000.0 << "ms\n"
+            << "key   " << stats_.keyLatency << "ms\n";
+        stats_.text = text.str();
+
+        stats_.vm = Clock::duration::zero();
+        stats_.draw = Clock::duration::zero();
+        stats_.elapsed = 0.0f;
+        stats_.frames = 0;
+        stats_.cycles = cycles;
+    }
+
+    // Text is drawn at one character cell per display pixel.
+    olc::vf2d scale{ 1.0f / SCALE, 1.0f / SCALE };
+    FillRectDecal({ 0.0f, 0.0f }, { 14.0f * scale.x * 8, 7.0f * scale.y * 8 },
+        olc::Pixel(0, 0, 0, 160));
+    DrawStringDecal({ 0.0f, 0.0f }, stats_.text, olc::GREEN, scale);
+}
+
+// Text is drawn at one character cell per display pixel.
+void View::drawStatus() {
+    auto status = debugger_->status();
+    auto lines = std::count(status.begin(), status.end(), '\n');
+    olc::vf2d scale{ 1.0f / SCALE, 1.0f / SCALE };
+    olc::vf2d origin{ 0.0f, SCREEN_HEIGHT - lines * scale.y * 8 };
+
+    FillRectDecal(origin, { SCREEN_WIDTH, lines * scale.y * 8 },
+        olc::Pixel(0, 0, 0, 160));
+    DrawStringDecal(origin, status, olc::YELLOW, scale);
+}
+
+// F5 pauses or continues, F10 steps over a call and F11 steps.
+void View::handleDebugger() {
+    debugger_->poll();
+
+    if (GetKey(olc::Key::F5).bPressed) {
+        debugger_->execute(debugger_->paused() ? "c" : "p");
+    } else if (GetKey(olc::Key::F10).bPressed) {
+        debugger_->execute("n");
+    } else if (GetKey(olc::Key::F11).bPressed) {
+        debugger_->execute("s");
+    }
+}
+
+// With a debugger attached the VM is run here, an instruction at a time as
+// they fall due, so that it can stop between any two.
+void View::step(float elapsed) {
     cpuLag_ += elapsed;
     interruptLag_ += elapsed;
 
-    if (cpuLag_ >= CPU_TICK) {
-        cpuLag_ -= CPU_TICK;
-
-        handleInput();
-        vm_.cycle();
-        draw();
+    if (cpuLag_ >= cpuTick_) {
+        cpuLag_ -= cpuTick_;
+        debugger_->cycle();
     }
 
     if (interruptLag_ >= INTERRUPT_TICK) {
         interruptLag_ -= INTERRUPT_TICK;
+        debugger_->handleInterrupts();
+        latch_.latch(vm_, frame_);
 
-        if (vm_.isBeeping()) {
-            soundengine_.PlayWaveform(&beep_);
+        if (recorder_) {
+            recorder_->record(vm_);
         }
-        vm_.handleInterrupts();
     }
 
-    return true;
-}
+    beeper_.advance(vm_.cycles());
 
-void View::draw() {
-    for (auto row = 0; row < SCREEN_HEIGHT; row++) {
-        for (auto col = 0; col < SCREEN_WIDTH; col++) {
-            Draw(col, row, vm_.pixelAt(row, col) ? olc::WHITE : olc::BLACK);
-        }
+    // Stepping through a paused program should show every change.
+    if (debugger_->paused()) {
+        latch_.latch(vm_, frame_);
     }
 }
 
 void View::handleInput() {
-    for (auto& key : keys_) {
-        if (GetKey(key.second).bPressed || GetKey(key.second).bHeld) {
-            vm_.input(key.first, true);
-        } else {
-            vm_.input(key.first, false);
-        }
+    uint16_t state = 0;
+
+    for (std::size_t i = 0; i < keys_.size(); i++) {
+        auto key = GetKey(keys_[i]);
+        state |= static_cast<uint16_t>(key.bPressed || key.bHeld) << i;
+    }
+
+    if (state & ~keyState_) {
+        stats_.keyPending = true;
+        stats_.keyTime = Clock::now();
+    }
+    keyState_ = state;
+
+    if (emulator_) {
+        emulator_->setKeys(state);
+    } else {
+        vm_.setKeys(state);
     }
 }
 
+// A decimal number from 1 to 65535.
+static bool toPort(const char* arg, uint16_t& port) {
+    char* end;
+    auto value = std::strtol(arg, &end, 10);
+    if (*arg == '\0' || *end != '\0' || value < 1 || value > 0xFFFF) {
+        return false;
+    }
+    port = static_cast<uint16_t>(value);
+    return true;
+}
+
 int main(int argc, const char* argv[]) {
     setlocale(LC_ALL, "POSIX");
 
@@ -180,22 +493,118 @@ int main(int argc, const char* argv[]) {
     signal(SIGTERM, system_end);
 #endif
 
+    const char* index = nullptr;
+    const char* filename = nullptr;
+    const char* videofile = nullptr;
+    Filter::Type filter = Filter::Type::NONE;
+    bool blend = false;
+    bool overlay = false;
+    bool debug = false;
+    uint16_t port = 0;
+
+    for (auto i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            index = argv[++i];
+        } else if (std::strcmp(argv[i], "-p") == 0) {
+            overlay = true;
+        } else if (std::strcmp(argv[i], "-b") == 0) {
+            blend = true;
+        } else if (std::strcmp(argv[i], "-d") == 0) {
+            debug = true;
+        } else if (std::strcmp(argv[i], "-D") == 0 && i + 1 < argc &&
+        toPort(argv[i + 1], port)) {
+            i++;
+        } else if (std::strcmp(argv[i], "-v") == 0 && i + 1 < argc) {
+            videofile = argv[++i];
+        } else if (std::strcmp(argv[i], "-f") == 0 && i + 1 < argc &&
+        Filter::lookup(argv[i + 1], filter)) {
+            i++;
+        } else if (argv[i][0] == '-') {
+            std::cerr << "Usage: " << argv[0]
+                << " [-i index] [-p] [-d] [-D port] [-b] [-f filter] [-v video]"
+                " [rom]\n  filters: " << Filter::names() << '\n';
+            return EXIT_FAILURE;
+        } else {
+            filename = argv[i];
+        }
+    }
+
     Chip8VM vm;
+    View view(vm);
+    view.showOverlay(overlay);
+    view.setFilter(filter);
+    view.setBlend(blend);
+
+    std::unique_ptr<Debugger> debugger;
+    if (debug || port) {
+        debugger = std::make_unique<Debugger>(vm);
+        view.attach(debugger.get());
 
-    if (argc > 1) {
         try {
-            vm.load(argv[1]);
-        } catch (...) {
-            std::cerr << "Could not load " << argv[1] << '\n';
+            if (port) {
+                debugger->listen(port);
+            }
+            if (debug) {
+                debugger->listenStdin();
+            }
+        } catch (std::exception& e) {
+            std::cerr << "Could not start debugger: " << e.what() << '\n';
             return EXIT_FAILURE;
         }
     }
 
-    View view(vm);
+    if (filename) {
+        try {
+            Rom rom(filename);
+            vm.load(rom);
+
+            if (index) {
+                RomLibrary library;
+                library.loadIndex(index);
+
+                auto info = library.lookup(rom);
+                if (info) {
+                    vm.setQuirks(info->quirks);
+                    view.configure(*info);
+                }
+            }
+        } catch (std::exception& e) {
+            std::cerr << "Could not load " << filename << ": " << e.what()
+                << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::unique_ptr<Recorder> recorder;
+    if (videofile) {
+        try {
+            recorder = std::make_unique<Recorder>(videofile, SCALE);
+            view.record(recorder.get());
+        } catch (std::exception& e) {
+            std::cerr << "Could not record to " << videofile << ": "
+                << e.what() << '\n';
+            return EXIT_FAILURE;
+        }
+    }
 
     if (view.Construct(SCREEN_WIDTH, SCREEN_HEIGHT, SCALE, SCALE)) {
         view.Start();
     }
 
+    if (recorder) {
+        try {
+            recorder->close();
+        } catch (std::exception& e) {
+            std::cerr << "Could not write " << videofile << ": " << e.what()
+                << '\n';
+            return EXIT_FAILURE;
+        }
+
+        if (recorder->dropped()) {
+            std::cerr << recorder->dropped() << " frames were dropped from "
+                << videofile << " because it couldn't be written fast enough\n";
+        }
+    }
+
 	return EXIT_SUCCESS;
 }
\ No newline at end of file
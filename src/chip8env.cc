@@ -0,0 +1,296 @@
+//
+// CHIP-8 emulator
+//
+// By Jaldhar H. Vyas <jaldhar@braincells.com>
+// Copyright (C) 2021, Consolidated Braincells Inc.  All rights reserved.
+// "Do what thou wilt" shall be the whole of the license.
+//
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "chip8env.h"
+#include "compiled.h"
+#include "pool.h"
+#include "rom.h"
+#include "vm.h"
+
+constexpr static int DEFAULT_TICKRATE = 4;
+
+// Bits in reverse order; bit n of a display row is column n but the
+// leftmost pixel goes in the highest bit of an observation byte.
+constexpr static std::array<uint8_t, 256> REVERSED = [] {
+    std::array<uint8_t, 256> table{};
+    for (auto i = 0; i < 256; i++) {
+        for (auto bit = 0; bit < 8; bit++) {
+            if (i & (1 << bit)) {
+                table[i] |= 0x80 >> bit;
+            }
+        }
+    }
+    return table;
+}();
+
+// Aligned so that environments stepped by different threads don't share a
+// cache line.
+struct alignas(64) chip8_env {
+    Chip8VM         vm;
+    chip8_config    config;
+    int             score;      // at the reward address after the last step
+};
+
+static int score(const chip8_env* env) {
+    auto address = env->config.reward_address;
+    switch (env->config.reward_size) {
+        case 1:
+            return env->vm.memoryAt(address);
+        case 2:
+            return (env->vm.memoryAt(address) << 8) |
+                env->vm.memoryAt(address + 1);
+        default:
+            return 0;
+    }
+}
+
+static float step(chip8_env* env, uint16_t action, int frameskip, bool& done) {
+    env->vm.setKeys(action);
+    for (auto i = 0; i < frameskip && !env->vm.faults(); i++) {
+        env->vm.run(env->config.tickrate);
+        env->vm.handleInterrupts();
+    }
+
+    auto current = score(env);
+    float reward = current - env->score;
+    env->score = current;
+    done = env->vm.faults() != 0;
+
+    return reward;
+}
+
+// Each environment in a vector is stepped by one of the threads; the calling
+// thread does its share too.  Workers wait for the generation to change,
+// step their slice of the environments with whatever is in the job, and
+// the last one to finish wakes up the caller.
+struct chip8_vec {
+    struct Job {
+        const uint16_t* actions;
+        int             frameskip;
+        uint8_t*        observations;
+        float*          rewards;
+        uint8_t*        dones;
+    };
+
+    chip8_vec(std::vector<chip8_env>&& e, int threads) : envs{std::move(e)},
+    job{}, mutex{}, start{}, finished{}, generation{0}, remaining{0},
+    stopping{false}, slices{threads}, workers{} {
+        for (auto i = 1; i < slices; i++) {
+            workers.emplace_back(&chip8_vec::work, this, i);
+        }
+    }
+
+    ~chip8_vec() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        start.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    chip8_vec(const chip8_vec&) = delete;
+    chip8_vec& operator=(const chip8_vec&) = delete;
+
+    void run(const Job& next) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = next;
+            remaining = slices - 1;
+            generation++;
+        }
+        start.notify_all();
+
+        stepSlice(0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [this] { return remaining == 0; });
+    }
+
+    void stepSlice(int slice) {
+        std::size_t first = envs.size() * slice / slices;
+        std::size_t last = envs.size() * (slice + 1) / slices;
+        for (auto i = first; i < last; i++) {
+            bool done;
+            job.rewards[i] = step(&envs[i], job.actions[i], job.frameskip,
+                done);
+            job.dones[i] = done;
+            chip8_env_observe(&envs[i],
+                job.observations + i * CHIP8_OBSERVATION_SIZE);
+        }
+    }
+
+    void work(int slice) {
+        uint64_t seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                start.wait(lock, [this, seen] {
+                    return stopping || generation != seen;
+                });
+                if (stopping) {
+                    return;
+                }
+                seen = generation;
+            }
+
+            stepSlice(slice);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--remaining == 0) {
+                finished.notify_one();
+            }
+        }
+    }
+
+    std::vector<chip8_env>      envs;
+    Job                         job;
+    std::mutex                  mutex;      // guards the rest
+    std::condition_variable     start;
+    std::condition_variable     finished;
+    uint64_t                    generation;
+    int                         remaining;  // workers still stepping
+    bool                        stopping;
+    int                         slices;
+    std::vector<std::thread>    workers;
+};
+
+void chip8_config_default(chip8_config* config) {
+    config->tickrate = DEFAULT_TICKRATE;
+    config->quirks = CHIP8_QUIRK_LOGIC;
+    config->reward_address = 0;
+    config->reward_size = 0;
+}
+
+chip8_env* chip8_env_create(const uint8_t* rom, size_t size,
+const chip8_config* config) {
+    if (!config || (!rom && size) || config->tickrate <= 0 ||
+    config->reward_size < 0 || config->reward_size > 2) {
+        return nullptr;
+    }
+
+    try {
+        Rom image(rom, size);
+        auto env = Pool<chip8_env>::make(chip8_env{ Chip8VM{}, *config, 0 });
+
+        Quirks quirks;
+        quirks.logic = config->quirks & CHIP8_QUIRK_LOGIC;
+        quirks.shift = config->quirks & CHIP8_QUIRK_SHIFT;
+        quirks.memoryLeaveIUnchanged = config->quirks & CHIP8_QUIRK_MEMORY;
+        quirks.jump = config->quirks & CHIP8_QUIRK_JUMP;
+        quirks.wrap = config->quirks & CHIP8_QUIRK_WRAP;
+
+        env->vm.load(image);
+        env->vm.setCompiled(findCompiledRom(image.hash()));
+        env->vm.setQuirks(quirks);
+        chip8_env_reset(env.get(), 0);
+
+        return env.release();
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+chip8_env* chip8_env_clone(const chip8_env* env) {
+    try {
+        return Pool<chip8_env>::make(*env).release();
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+// Unlike clone, doesn't allocate anything so it is suitable for saving and
+// restoring states in a search.
+void chip8_env_copy(chip8_env* to, const chip8_env* from) {
+    *to = *from;
+}
+
+void chip8_env_destroy(chip8_env* env) {
+    if (env) {
+        Pool<chip8_env>::Deleter{}(env);
+    }
+}
+
+void chip8_env_observe(const chip8_env* env, uint8_t* observation) {
+    for (auto row = 0; row < SCREEN_HEIGHT; row++) {
+        auto pixels = env->vm.displayRow(row);
+        for (auto byte = 0; byte < SCREEN_WIDTH / 8; byte++) {
+            *observation++ = REVERSED[(pixels >> (byte * 8)) & 0xFF];
+        }
+    }
+}
+
+void chip8_env_reset(chip8_env* env, uint32_t seed) {
+    env->vm.reset(true);
+    env->vm.seed(seed);
+    env->score = score(env);
+}
+
+float chip8_env_step(chip8_env* env, uint16_t action, int frameskip,
+int* done) {
+    bool finished;
+    auto reward = step(env, action, frameskip, finished);
+    if (done) {
+        *done = finished;
+    }
+    return reward;
+}
+
+chip8_vec* chip8_vec_create(const uint8_t* rom, size_t size,
+const chip8_config* config, int count, int threads) {
+    if (count <= 0) {
+        return nullptr;
+    }
+    if (threads <= 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = std::min(threads, count);
+
+    Pool<chip8_env>::Ptr first(chip8_env_create(rom, size, config));
+    if (!first) {
+        return nullptr;
+    }
+
+    try {
+        std::vector<chip8_env> envs(count, *first);
+        return new chip8_vec(std::move(envs), threads);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void chip8_vec_destroy(chip8_vec* vec) {
+    delete vec;
+}
+
+chip8_env* chip8_vec_env(chip8_vec* vec, int index) {
+    if (index < 0 || static_cast<std::size_t>(index) >= vec->envs.size()) {
+        return nullptr;
+    }
+    return &vec->envs[index];
+}
+
+void chip8_vec_reset(chip8_vec* vec, const uint32_t* seeds) {
+    for (std::size_t i = 0; i < vec->envs.size(); i++) {
+        chip8_env_reset(&vec->envs[i], seeds ? seeds[i] : i);
+    }
+}
+
+void chip8_vec_step(chip8_vec* vec, const uint16_t* actions, int frameskip,
+uint8_t* observations, float* rewards, uint8_t* dones) {
+    vec->run(chip8_vec::Job{ actions, frameskip, observations, rewards,
+        dones });
+}
@@ -0,0 +1,26 @@
+//
+// CHIP-8 emulator
+//
+// By Jaldhar H. Vyas <jaldhar@braincells.com>
+// Copyright (C) 2021, Consolidated Braincells Inc.  All rights reserved.
+// "Do what thou wilt" shall be the whole of the license.
+//
+
+#include <unordered_map>
+#include "compiled.h"
+
+// Generated code registers itself during static initialization so the
+// registry has to be created on first use.
+static std::unordered_map<std::string, const CompiledRom*>& registry() {
+    static std::unordered_map<std::string, const CompiledRom*> roms;
+    return roms;
+}
+
+bool registerCompiledRom(const CompiledRom& rom) {
+    return registry().emplace(rom.hash, &rom).second;
+}
+
+const CompiledRom* findCompiledRom(const std::string& hash) {
+    auto entry = registry().find(hash);
+    return (entry != registry().end()) ? entry->second : nullptr;
+}
@@ -0,0 +1,507 @@
+//
+// CHIP-8 emulator
+//
+// By Jaldhar H. Vyas <jaldhar@braincells.com>
+// Copyright (C) 2021, Consolidated Braincells Inc.  All rights reserved.
+// "Do what thou wilt" shall be the whole of the license.
+//
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include "debugger.h"
+#include "opcodes.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+constexpr static uint16_t DEFAULT_DUMP_LENGTH = 0x40;
+
+static const char* HELP =
+    "c               continue\n"
+    "p               pause\n"
+    "s               step one instruction\n"
+    "n               step over a subroutine call\n"
+    "r               show registers and stack\n"
+    "m ADDR [LEN]    show memory\n"
+    "b ADDR          set a breakpoint (debug build only)\n"
+    "db ADDR         delete a breakpoint\n"
+    "w ADDR|i|vX     watch a memory location, I or a register\n"
+    "dw ADDR|i|vX    delete a watchpoint\n"
+    "l               list breakpoints and watchpoints\n"
+    "h               this help\n"
+    "Numbers are in hexadecimal.\n";
+
+static bool parseNumber(const std::string& token, uint16_t& number) {
+    try {
+        std::size_t end;
+        auto value = std::stoul(token, &end, 16);
+        if (end != token.size() || value > 0xFFFF) {
+            return false;
+        }
+        number = static_cast<uint16_t>(value);
+        return true;
+    } catch (...) {
+        return false;
+    }
+}
+
+Debugger::Debugger(Chip8VM& vm) : vm_{vm}, paused_{true}, stepping_{false},
+returnPC_{0}, returnSP_{0}, watchpoints_{}, mutex_{}, requests_{},
+closing_{false}, echo_{false}, clientMutex_{}, client_{-1}, server_{-1},
+serverThread_{}, stdinDone_{false}, stopStdin_{-1, -1}, stdinThread_{} {
+}
+
+Debugger::~Debugger() {
+    // From now on the console threads get an empty reply to anything they
+    // submit instead of waiting for a poll() which will never come.
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closing_ = true;
+        for (auto& request : requests_) {
+            request.reply.set_value("");
+        }
+        requests_.clear();
+    }
+
+#ifdef _WIN32
+    // A console read can only be interrupted by cancelling it, and the
+    // thread may not have started the read yet, so keep trying.
+    while (stdinThread_.joinable() && !stdinDone_) {
+        CancelSynchronousIo(stdinThread_.native_handle());
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+#else
+    if (stopStdin_[1] != -1) {
+        char stop = 0;
+        (void)!write(stopStdin_[1], &stop, 1);
+    }
+
+    int server = server_.exchange(-1);
+    if (server != -1) {
+        shutdown(server, SHUT_RDWR);
+        close(server);
+    }
+    {
+        std::lock_guard<std::mutex> lock(clientMutex_);
+        if (client_ != -1) {
+            shutdown(client_, SHUT_RDWR);
+        }
+    }
+#endif
+
+    if (serverThread_.joinable()) {
+        serverThread_.join();
+    }
+    if (stdinThread_.joinable()) {
+        stdinThread_.join();
+    }
+
+#ifndef _WIN32
+    for (auto fd : stopStdin_) {
+        if (fd != -1) {
+            close(fd);
+        }
+    }
+#endif
+}
+
+void Debugger::cycle() {
+    if (paused_) {
+        return;
+    }
+
+    vm_.cycle();
+
+#ifdef DEBUG
+    if (vm_.halted_) {
+        vm_.halted_ = false;
+        pause("Breakpoint");
+        return;
+    }
+#endif
+
+    if (stepping_ && vm_.PC_ == returnPC_ && vm_.SP_ == returnSP_) {
+        pause("Stepped over");
+        return;
+    }
+
+    if (!watchpoints_.empty()) {
+        checkWatchpoints();
+    }
+}
+
+void Debugger::handleInterrupts() {
+    if (!paused_) {
+        vm_.handleInterrupts();
+    }
+}
+
+bool Debugger::paused() const {
+    return paused_;
+}
+
+std::string Debugger::execute(const std::string& command) {
+    std::istringstream input(command);
+    std::string verb;
+    std::string arg1;
+    std::string arg2;
+    input >> verb >> arg1 >> arg2;
+
+    if (verb.empty()) {
+        return "";
+    } else if (verb == "h") {
+        return HELP;
+    } else if (verb == "c") {
+        // Get off a breakpoint before carrying on.
+        if (paused_) {
+            vm_.execute();
+        }
+        paused_ = false;
+        stepping_ = false;
+        return "";
+    } else if (verb == "p") {
+        paused_ = true;
+        stepping_ = false;
+        return status();
+    } else if (verb == "s") {
+        paused_ = true;
+        stepping_ = false;
+        vm_.execute();
+        checkWatchpoints();
+        return status();
+    } else if (verb == "n") {
+        auto opcode = vm_.memory_[vm_.PC_ & MEM_MASK] >> 4;
+        paused_ = true;
+        stepping_ = false;
+        if (opcode == 0x2) {
+            returnPC_ = vm_.PC_ + 2;
+            returnSP_ = vm_.SP_;
+            vm_.execute();
+            stepping_ = true;
+            paused_ = false;
+            return "";
+        }
+        vm_.execute();
+        checkWatchpoints();
+        return status();
+    } else if (verb == "r") {
+        return status();
+    } else if (verb == "m") {
+        uint16_t address;
+        uint16_t length = DEFAULT_DUMP_LENGTH;
+        if (!parseNumber(arg1, address) ||
+        (!arg2.empty() && !parseNumber(arg2, length))) {
+            return "Usage: m ADDR [LEN]\n";
+        }
+        return memory(address, length);
+    } else if (verb == "b" || verb == "db") {
+        uint16_t address;
+        if (!parseNumber(arg1, address)) {
+            return "Usage: " + verb + " ADDR\n";
+        }
+#ifdef DEBUG
+        vm_.breakpoints_.set(address & MEM_MASK, verb == "b");
+        return "";
+#else
+        return "Breakpoints are only available in the debug build.\n";
+#endif
+    } else if (verb == "w" || verb == "dw") {
+        Watchpoint watchpoint{ Watch::MEMORY, 0, 0 };
+        if (arg1 == "i") {
+            watchpoint.kind = Watch::I;
+        } else if (arg1.size() == 2 && arg1[0] == 'v' &&
+        parseNumber(arg1.substr(1), watchpoint.where)) {
+            watchpoint.kind = Watch::REGISTER;
+        } else if (parseNumber(arg1, watchpoint.where)) {
+            watchpoint.where &= MEM_MASK;
+        } else {
+            return "Usage: " + verb + " ADDR|i|vX\n";
+        }
+
+        for (auto it = watchpoints_.begin(); it != watchpoints_.end(); ++it) {
+            if (it->kind == watchpoint.kind && it->where == watchpoint.where) {
+                watchpoints_.erase(it);
+                break;
+            }
+        }
+        if (verb == "w") {
+            watchpoint.value = valueOf(watchpoint);
+            watchpoints_.push_back(watchpoint);
+        }
+        return "";
+    } else if (verb == "l") {
+        std::ostringstream out;
+#ifdef DEBUG
+        for (auto i = 0; i < MEM_SIZE; i++) {
+            if (vm_.breakpoints_.test(i)) {
+                out << "break " << hex(i, 4) << '\n';
+            }
+        }
+#endif
+        for (auto& watchpoint : watchpoints_) {
+            out << "watch ";
+            switch (watchpoint.kind) {
+                case Watch::MEMORY:
+                    out << hex(watchpoint.where, 4);
+                    break;
+                case Watch::I:
+                    out << 'i';
+                    break;
+                case Watch::REGISTER:
+                    out << 'v' << hex(watchpoint.where, 1);
+                    break;
+            }
+            out << '\n';
+        }
+        return out.str();
+    }
+
+    return "Unknown command " + verb + "; h for help.\n";
+}
+
+void Debugger::poll() {
+    std::deque<Request> requests;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        requests.swap(requests_);
+    }
+
+    for (auto& request : requests) {
+        request.reply.set_value(execute(request.command));
+    }
+}
+
+// Registers, stack and the next instruction.
+std::string Debugger::status() const {
+    std::ostringstream out;
+    auto pc = vm_.PC_ & MEM_MASK;
+
+    uint16_t word = vm_.memory_.word(pc);
+
+    out << "PC " << hex(vm_.PC_, 4) << " [" << hex(word, 4) << "] "
+        << disassemble(word) << '\n'
+        << "I " << hex(vm_.I_, 4) << " SP " << hex(vm_.SP_, 2)
+        << " DT " << hex(vm_.DT_, 2) << " ST " << hex(vm_.ST_, 2) << '\n';
+
+    for (auto i = 0; i < 16; i++) {
+        out << 'V' << hex(i, 1) << ' ' << hex(vm_.V_[i], 2)
+            << ((i % 8 == 7) ? '\n' : ' ');
+    }
+
+    out << "stack";
+    for (auto i = 0; i < std::min<int>(vm_.SP_, STACK_SIZE); i++) {
+        out << ' ' << hex(vm_.stack_[i], 4);
+    }
+    out << '\n';
+
+    return out.str();
+}
+
+void Debugger::checkWatchpoints() {
+    for (auto& watchpoint : watchpoints_) {
+        auto value = valueOf(watchpoint);
+        if (value != watchpoint.value) {
+            std::string what = (watchpoint.kind == Watch::MEMORY) ?
+                hex(watchpoint.where, 4) : (watchpoint.kind == Watch::I) ?
+                "I" : "V" + hex(watchpoint.where, 1);
+            std::string reason = "Watchpoint " + what + " changed from " +
+                hex(watchpoint.value, 2) + " to " + hex(value, 2);
+            watchpoint.value = value;
+            pause(reason);
+        }
+    }
+}
+
+std::string Debugger::memory(uint16_t address, uint16_t length) const {
+    std::ostringstream out;
+
+    for (uint16_t i = 0; i < length; i++) {
+        uint16_t where = (address + i) & MEM_MASK;
+        if (i % 16 == 0) {
+            out << hex(where, 4) << ':';
+        }
+        out << ' ' << hex(vm_.memory_[where], 2);
+        if (i % 16 == 15 || i == length - 1) {
+            out << '\n';
+        }
+    }
+
+    return out.str();
+}
+
+void Debugger::notify(const std::string& message) {
+    if (echo_) {
+        std::cout << message << "> " << std::flush;
+    }
+
+#ifndef _WIN32
+    // The socket is only closed with the mutex held so its descriptor
+    // can't be reused for something else while this is sending.
+    std::lock_guard<std::mutex> lock(clientMutex_);
+    if (client_ != -1) {
+        std::string text = message + "> ";
+        send(client_, text.data(), text.size(), MSG_NOSIGNAL);
+    }
+#endif
+}
+
+void Debugger::pause(const std::string& reason) {
+    paused_ = true;
+    stepping_ = false;
+    notify(reason + '\n' + status());
+}
+
+std::string Debugger::submit(const std::string& command) {
+    std::future<std::string> reply;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closing_) {
+            return "";
+        }
+        requests_.push_back(Request{ command, {} });
+        reply = requests_.back().reply.get_future();
+    }
+
+    return reply.get();
+}
+
+uint16_t Debugger::valueOf(const Watchpoint& watchpoint) const {
+    switch (watchpoint.kind) {
+        case Watch::MEMORY:
+            return vm_.memory_[watchpoint.where];
+        case Watch::I:
+            return vm_.I_;
+        case Watch::REGISTER:
+            return vm_.V_[watchpoint.where & 0xF];
+    }
+
+    return 0;
+}
+
+// stdin is read directly rather than through std::cin so that the thread
+// can wait for either input or the destructor telling it to stop.
+void Debugger::listenStdin() {
+#ifdef _WIN32
+    echo_ = true;
+    std::cout << "> " << std::flush;
+
+    stdinThread_ = std::thread([this] {
+        std::string line;
+        while (std::getline(std::cin, line)) {
+            std::cout << submit(line) << "> " << std::flush;
+        }
+        stdinDone_ = true;
+    });
+#else
+    if (pipe(stopStdin_) == -1) {
+        throw std::runtime_error("could not create pipe");
+    }
+    echo_ = true;
+    std::cout << "> " << std::flush;
+
+    stdinThread_ = std::thread([this] {
+        pollfd fds[] = {
+            { STDIN_FILENO, POLLIN, 0 },
+            { stopStdin_[0], POLLIN, 0 },
+        };
+        std::string buffer;
+        char chunk[256];
+
+        while (::poll(fds, 2, -1) != -1 || errno == EINTR) {
+            if (fds[1].revents) {
+                break;
+            }
+            if (!fds[0].revents) {
+                continue;
+            }
+
+            auto n = read(STDIN_FILENO, chunk, sizeof chunk);
+            if (n <= 0) {
+                break;
+            }
+            buffer.append(chunk, n);
+
+            std::size_t eol;
+            while ((eol = buffer.find('\n')) != std::string::npos) {
+                auto line = buffer.substr(0, eol);
+                buffer.erase(0, eol + 1);
+                std::cout << submit(line) << "> " << std::flush;
+            }
+        }
+        stdinDone_ = true;
+    });
+#endif
+}
+
+// One client at a time may connect to 127.0.0.1:port.
+void Debugger::listen(uint16_t port) {
+#ifdef _WIN32
+    (void)port;
+    throw std::runtime_error("the TCP console is not available on Windows");
+#else
+    int server = socket(AF_INET, SOCK_STREAM, 0);
+    if (server == -1) {
+        throw std::runtime_error("could not create socket");
+    }
+
+    int yes = 1;
+    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof yes);
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(server, reinterpret_cast<sockaddr*>(&address), sizeof address)
+    == -1 || ::listen(server, 1) == -1) {
+        close(server);
+        throw std::runtime_error("could not listen on port " +
+            std::to_string(port));
+    }
+    server_ = server;
+
+    serverThread_ = std::thread([this, server] {
+        int client;
+        while ((client = accept(server, nullptr, nullptr)) != -1) {
+            {
+                std::lock_guard<std::mutex> lock(clientMutex_);
+                client_ = client;
+            }
+            send(client, "> ", 2, MSG_NOSIGNAL);
+
+            std::string buffer;
+            char chunk[256];
+            ssize_t n;
+            while ((n = recv(client, chunk, sizeof chunk, 0)) > 0) {
+                buffer.append(chunk, n);
+
+                std::size_t eol;
+                while ((eol = buffer.find('\n')) != std::string::npos) {
+                    auto line = buffer.substr(0, eol);
+                    buffer.erase(0, eol + 1);
+                    if (!line.empty() && line.back() == '\r') {
+                        line.pop_back();
+                    }
+                    auto reply = submit(line) + "> ";
+                    send(client, reply.data(), reply.size(), MSG_NOSIGNAL);
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(clientMutex_);
+            client_ = -1;
+            close(client);
+        }
+    });
+#endif
+}
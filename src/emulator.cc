@@ -0,0 +1,165 @@
+//
+// CHIP-8 emulator
+//
+// By Jaldhar H. Vyas <jaldhar@braincells.com>
+// Copyright (C) 2021, Consolidated Braincells Inc.  All rights reserved.
+// "Do what thou wilt" shall be the whole of the license.
+//
+
+#include <cmath>
+#include "beeper.h"
+#include "emulator.h"
+#include "recorder.h"
+
+constexpr static int FPS = 60;
+constexpr static int SLICES = 4;            // per frame
+constexpr static int MAX_LAG = FPS / 10;    // frames to catch up at most
+
+Latch::Latch() : blend_{false}, previous_{} {
+}
+
+bool Latch::blend() const {
+    return blend_;
+}
+
+void Latch::latch(const Chip8VM& vm, Frame& frame) {
+    for (auto row = 0; row < SCREEN_HEIGHT; row++) {
+        auto current = vm.displayRow(row);
+        frame[row] = blend_ ? (current | previous_[row]) : current;
+        previous_[row] = current;
+    }
+}
+
+void Latch::setBlend(bool blend) {
+    blend_ = blend;
+}
+
+Emulator::Emulator(Chip8VM& vm, Beeper& beeper, int tickrate) : vm_{vm},
+beeper_{beeper}, recorder_{nullptr}, tickrate_{tickrate}, latch_{},
+frames_{}, keys_{0}, speed_{1.0}, running_{false}, busy_{0},
+cycles_{vm.cycles()}, faults_{0}, thread_{} {
+}
+
+Emulator::~Emulator() {
+    stop();
+}
+
+void Emulator::setBlend(bool blend) {
+    latch_.setBlend(blend);
+}
+
+// Every frame is recorded, whether or not it is shown.
+void Emulator::setRecorder(Recorder* recorder) {
+    recorder_ = recorder;
+}
+
+void Emulator::start() {
+    if (thread_.joinable()) {
+        return;
+    }
+    running_.store(true, std::memory_order_release);
+    thread_ = std::thread(&Emulator::run, this);
+}
+
+void Emulator::stop() {
+    running_.store(false, std::memory_order_release);
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+std::chrono::nanoseconds Emulator::busy() {
+    return std::chrono::nanoseconds(busy_.exchange(0));
+}
+
+uint64_t Emulator::cycles() const {
+    return cycles_.load(std::memory_order_relaxed);
+}
+
+uint8_t Emulator::faults() const {
+    return faults_.load(std::memory_order_acquire);
+}
+
+void Emulator::setKeys(uint16_t keys) {
+    keys_.store(keys, std::memory_order_relaxed);
+}
+
+void Emulator::setSpeed(double speed) {
+    speed_.store(speed, std::memory_order_relaxed);
+}
+
+bool Emulator::frame(Frame& frame) {
+    if (!frames_.update()) {
+        return false;
+    }
+    frame = frames_.front();
+    return true;
+}
+
+// Slices are run on a fixed schedule measured from when the thread started,
+// so the time taken to run them or oversleeping doesn't add up.  If the
+// thread falls a long way behind, e.g. because the host was suspended, it
+// starts a new schedule from now instead of racing to catch up.  So does a
+// change of speed.  The new schedule is in step with the old one so the
+// frame in progress still ends after SLICES slices.
+//
+// The beeper follows the same speed so the sound keeps up with fast-forward.
+void Emulator::run() {
+    using Clock = std::chrono::steady_clock;
+    auto speed = speed_.load(std::memory_order_relaxed);
+    auto after = [&speed](int64_t slices) {
+        return std::chrono::nanoseconds(std::llround(slices * 1.0e9 /
+            (FPS * SLICES * speed)));
+    };
+    beeper_.setSpeed(speed);
+
+    auto begin = Clock::now();
+    int64_t slices = 0;
+
+    while (running_.load(std::memory_order_acquire)) {
+        auto start = Clock::now();
+        auto slice = slices % SLICES;
+
+        vm_.setKeys(keys_.load(std::memory_order_relaxed));
+        vm_.run(tickrate_ * (slice + 1) / SLICES - tickrate_ * slice / SLICES);
+        if (slice == SLICES - 1) {
+            endFrame();
+        }
+        beeper_.advance(vm_.cycles());
+
+        busy_ += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now() - start).count();
+
+        if (vm_.faults()) {
+            faults_.store(vm_.faults(), std::memory_order_release);
+            break;
+        }
+
+        slices++;
+        auto next = begin + after(slices);
+        auto now = Clock::now();
+        if (speed_.load(std::memory_order_relaxed) != speed ||
+        now - next > after(int64_t{MAX_LAG} * SLICES)) {
+            speed = speed_.load(std::memory_order_relaxed);
+            beeper_.setSpeed(speed);
+            slices %= SLICES;
+            begin = now - after(slices);
+            next = now;
+        }
+        std::this_thread::sleep_until(next);
+    }
+}
+
+// The vertical blank.
+void Emulator::endFrame() {
+    vm_.handleInterrupts();
+
+    latch_.latch(vm_, frames_.back());
+    frames_.publish();
+
+    if (recorder_) {
+        recorder_->record(vm_);
+    }
+
+    cycles_.store(vm_.cycles(), std::memory_order_relaxed);
+}
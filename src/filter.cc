@@ -0,0 +1,305 @@
+//
+// CHIP-8 emulator
+//
+// By Jaldhar H. Vyas <jaldhar@braincells.com>
+// Copyright (C) 2021, Consolidated Braincells Inc.  All rights reserved.
+// "Do what thou wilt" shall be the whole of the license.
+//
+
+#include <algorithm>
+#include <cmath>
+#include "filter.h"
+
+constexpr static uint32_t BLACK = 0xFF000000;
+constexpr static uint32_t WHITE = 0xFFFFFFFF;
+constexpr static uint32_t SCANLINE = 0xFF404040;    // a darkened white pixel
+constexpr static float PHOSPHOR_DECAY = 0.5f;       // brightness left per frame
+constexpr static float PHOSPHOR_BLACK = 1.0f / 255; // dimmer than this is off
+constexpr static int SCANLINE_ROWS = 4;             // lines per display row
+
+static const struct {
+    const char*     name;
+    Filter::Type    type;
+} FILTERS[] = {
+    { "none",       Filter::Type::NONE },
+    { "phosphor",   Filter::Type::PHOSPHOR },
+    { "scale2x",    Filter::Type::SCALE2X },
+    { "scale3x",    Filter::Type::SCALE3X },
+    { "scanlines",  Filter::Type::SCANLINES },
+};
+
+using Pixels = std::array<std::array<uint32_t, 8>, 256>;
+
+// The 8 pixels for each value of a byte of a row, leftmost in bit 0.
+constexpr static Pixels makePixels(uint32_t on, uint32_t off) {
+    Pixels pixels{};
+    for (auto byte = 0; byte < 256; byte++) {
+        for (auto bit = 0; bit < 8; bit++) {
+            pixels[byte][bit] = ((byte >> bit) & 1) ? on : off;
+        }
+    }
+    return pixels;
+}
+
+constexpr static Pixels PIXELS = makePixels(WHITE, BLACK);
+constexpr static Pixels DIMMED = makePixels(SCANLINE, BLACK);
+
+// Spreads the bits of a byte n apart so that n bytes can be interleaved by
+// shifting and ORing their spread values.
+template<int N>
+constexpr static std::array<uint32_t, 256> makeSpread() {
+    std::array<uint32_t, 256> spread{};
+    for (auto byte = 0; byte < 256; byte++) {
+        for (auto bit = 0; bit < 8; bit++) {
+            spread[byte] |= static_cast<uint32_t>((byte >> bit) & 1) <<
+                (bit * N);
+        }
+    }
+    return spread;
+}
+
+constexpr static std::array<uint32_t, 256> SPREAD2 = makeSpread<2>();
+constexpr static std::array<uint32_t, 256> SPREAD3 = makeSpread<3>();
+
+// Where c is set, x; elsewhere y.
+static inline uint64_t select(uint64_t c, uint64_t x, uint64_t y) {
+    return (c & x) | (~c & y);
+}
+
+static inline uint8_t byteOf(uint64_t bits, int n) {
+    return (bits >> (n * 8)) & 0xFF;
+}
+
+static uint32_t* expand(const uint8_t* bytes, int count, const Pixels& table,
+uint32_t* out) {
+    for (auto i = 0; i < count; i++) {
+        out = std::copy_n(table[bytes[i]].begin(), 8, out);
+    }
+    return out;
+}
+
+// One output line made from interleaving the pixels of a and b.
+static uint32_t* line2(uint64_t a, uint64_t b, uint32_t* out) {
+    uint8_t bytes[16];
+    for (auto i = 0; i < 8; i++) {
+        auto bits = SPREAD2[byteOf(a, i)] | (SPREAD2[byteOf(b, i)] << 1);
+        bytes[i * 2] = bits & 0xFF;
+        bytes[i * 2 + 1] = bits >> 8;
+    }
+    return expand(bytes, 16, PIXELS, out);
+}
+
+// One output line made from interleaving the pixels of a, b and c.
+static uint32_t* line3(uint64_t a, uint64_t b, uint64_t c, uint32_t* out) {
+    uint8_t bytes[24];
+    for (auto i = 0; i < 8; i++) {
+        auto bits = SPREAD3[byteOf(a, i)] | (SPREAD3[byteOf(b, i)] << 1) |
+            (SPREAD3[byteOf(c, i)] << 2);
+        bytes[i * 3] = bits & 0xFF;
+        bytes[i * 3 + 1] = (bits >> 8) & 0xFF;
+        bytes[i * 3 + 2] = bits >> 16;
+    }
+    return expand(bytes, 24, PIXELS, out);
+}
+
+Filter::Filter(Type type) : type_{type}, rows_{}, drawn_{false},
+fading_{false}, levels_{} {
+    if (type_ == Type::PHOSPHOR) {
+        levels_.assign(SCREEN_WIDTH * SCREEN_HEIGHT, 0.0f);
+    }
+}
+
+bool Filter::apply(const Rows& rows, float elapsed, uint32_t* pixels) {
+    if (drawn_ && rows == rows_ && !fading_) {
+        return false;
+    }
+    rows_ = rows;
+    drawn_ = true;
+
+    switch (type_) {
+        case Type::NONE:
+            none(pixels);
+            break;
+        case Type::PHOSPHOR:
+            phosphor(elapsed, pixels);
+            break;
+        case Type::SCALE2X:
+            scale2x(pixels);
+            break;
+        case Type::SCALE3X:
+            scale3x(pixels);
+            break;
+        case Type::SCANLINES:
+            scanlines(pixels);
+            break;
+    }
+
+    return true;
+}
+
+int Filter::height() const {
+    return SCREEN_HEIGHT * scaleY();
+}
+
+bool Filter::lookup(const std::string& name, Type& type) {
+    for (const auto& filter : FILTERS) {
+        if (name == filter.name) {
+            type = filter.type;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string Filter::names() {
+    std::string names;
+    for (const auto& filter : FILTERS) {
+        names += names.empty() ? "" : ", ";
+        names += filter.name;
+    }
+    return names;
+}
+
+int Filter::scaleX() const {
+    switch (type_) {
+        case Type::SCALE2X:
+            return 2;
+        case Type::SCALE3X:
+            return 3;
+        default:
+            return 1;
+    }
+}
+
+int Filter::scaleY() const {
+    switch (type_) {
+        case Type::SCALE2X:
+            return 2;
+        case Type::SCALE3X:
+            return 3;
+        case Type::SCANLINES:
+            return SCANLINE_ROWS;
+        default:
+            return 1;
+    }
+}
+
+int Filter::width() const {
+    return SCREEN_WIDTH * scaleX();
+}
+
+void Filter::none(uint32_t* out) const {
+    for (auto row : rows_) {
+        uint8_t bytes[8];
+        for (auto i = 0; i < 8; i++) {
+            bytes[i] = byteOf(row, i);
+        }
+        out = expand(bytes, 8, PIXELS, out);
+    }
+}
+
+// A lit pixel is at full brightness and an unlit one loses some of its
+// brightness every frame.  It keeps being redrawn while anything is fading.
+void Filter::phosphor(float elapsed, uint32_t* out) {
+    auto decay = std::pow(PHOSPHOR_DECAY, elapsed);
+    auto level = levels_.begin();
+    fading_ = false;
+
+    for (auto row : rows_) {
+        for (auto col = 0; col < SCREEN_WIDTH; col++, level++) {
+            if ((row >> col) & 1) {
+                *level = 1.0f;
+                *out++ = WHITE;
+                continue;
+            }
+
+            *level *= decay;
+            if (*level < PHOSPHOR_BLACK) {
+                *level = 0.0f;
+                *out++ = BLACK;
+                continue;
+            }
+
+            fading_ = true;
+            uint32_t grey = std::lround(*level * 255.0f);
+            *out++ = BLACK | (grey << 16) | (grey << 8) | grey;
+        }
+    }
+}
+
+// Each pixel E becomes 4 and its neighbours are
+//
+//      B           E0 E1
+//    D E F   =>    E2 E3
+//      H
+//
+// where E0 is D if D == B, D != H and B != F, otherwise E, and likewise for
+// the other corners.  Pixels off the edge of the display are unlit.
+void Filter::scale2x(uint32_t* out) const {
+    for (auto row = 0; row < SCREEN_HEIGHT; row++) {
+        uint64_t E = rows_[row];
+        uint64_t B = row > 0 ? rows_[row - 1] : 0;
+        uint64_t H = row < SCREEN_HEIGHT - 1 ? rows_[row + 1] : 0;
+        uint64_t D = E << 1;                // bit n is column n - 1
+        uint64_t F = E >> 1;                // bit n is column n + 1
+
+        auto E0 = select(~(D ^ B) & (D ^ H) & (B ^ F), D, E);
+        auto E1 = select(~(B ^ F) & (B ^ D) & (F ^ H), F, E);
+        auto E2 = select(~(D ^ H) & (D ^ B) & (H ^ F), D, E);
+        auto E3 = select(~(H ^ F) & (H ^ D) & (F ^ B), F, E);
+
+        out = line2(E0, E1, out);
+        out = line2(E2, E3, out);
+    }
+}
+
+// As scale2x but each pixel becomes 9 and the diagonal neighbours are used
+// for the edges.
+//
+//    A B C         E0 E1 E2
+//    D E F   =>    E3 E4 E5
+//    G H I         E6 E7 E8
+void Filter::scale3x(uint32_t* out) const {
+    for (auto row = 0; row < SCREEN_HEIGHT; row++) {
+        uint64_t E = rows_[row];
+        uint64_t B = row > 0 ? rows_[row - 1] : 0;
+        uint64_t H = row < SCREEN_HEIGHT - 1 ? rows_[row + 1] : 0;
+        uint64_t A = B << 1;
+        uint64_t C = B >> 1;
+        uint64_t D = E << 1;
+        uint64_t F = E >> 1;
+        uint64_t G = H << 1;
+        uint64_t I = H >> 1;
+
+        auto c0 = ~(D ^ B) & (D ^ H) & (B ^ F);
+        auto c2 = ~(B ^ F) & (B ^ D) & (F ^ H);
+        auto c6 = ~(D ^ H) & (D ^ B) & (H ^ F);
+        auto c8 = ~(H ^ F) & (H ^ D) & (F ^ B);
+
+        auto E0 = select(c0, D, E);
+        auto E1 = select((c0 & (E ^ C)) | (c2 & (E ^ A)), B, E);
+        auto E2 = select(c2, F, E);
+        auto E3 = select((c0 & (E ^ G)) | (c6 & (E ^ A)), D, E);
+        auto E5 = select((c2 & (E ^ I)) | (c8 & (E ^ C)), F, E);
+        auto E6 = select(c6, D, E);
+        auto E7 = select((c6 & (E ^ I)) | (c8 & (E ^ G)), H, E);
+        auto E8 = select(c8, F, E);
+
+        out = line3(E0, E1, E2, out);
+        out = line3(E3, E, E5, out);
+        out = line3(E6, E7, E8, out);
+    }
+}
+
+void Filter::scanlines(uint32_t* out) const {
+    for (auto row : rows_) {
+        uint8_t bytes[8];
+        for (auto i = 0; i < 8; i++) {
+            bytes[i] = byteOf(row, i);
+        }
+        for (auto line = 0; line < SCANLINE_ROWS - 1; line++) {
+            out = expand(bytes, 8, PIXELS, out);
+        }
+        out = expand(bytes, 8, DIMMED, out);
+    }
+}
@@ -0,0 +1,53 @@
+//
+// CHIP-8 emulator
+//
+// By Jaldhar H. Vyas <jaldhar@braincells.com>
+// Copyright (C) 2021, Consolidated Braincells Inc.  All rights reserved.
+// "Do what thou wilt" shall be the whole of the license.
+//
+
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include "opcodes.h"
+
+std::string hex(uint64_t value, int width) {
+    std::ostringstream out;
+    out << std::hex << std::uppercase << std::setfill('0') << std::setw(width) << value;
+    return out.str();
+}
+
+// Fills in the operands of an instruction from its OpInfo template.
+std::string disassemble(uint16_t word) {
+    const auto& info = opInfo(decodeOp(word));
+    std::string text = info.mnemonic;
+    if (*info.operands) {
+        text.append(5 - text.size(), ' ');
+    }
+
+    for (const char* p = info.operands; *p; p++) {
+        if (*p != '{') {
+            text += *p;
+            continue;
+        }
+
+        const char* end = std::strchr(p, '}');
+        std::string field(p + 1, end);
+        if (field == "x") {
+            text += hex((word >> 8) & 0xF, 1);
+        } else if (field == "y") {
+            text += hex((word >> 4) & 0xF, 1);
+        } else if (field == "n") {
+            text += hex(word & 0xF, 1);
+        } else if (field == "nn") {
+            text += hex(word & 0xFF, 2);
+        } else if (field == "nnn") {
+            text += hex(word & 0xFFF, 3);
+        } else if (field == "word") {
+            text += hex(word, 4);
+        }
+        p = end;
+    }
+
+    return text;
+}
@@ -0,0 +1,335 @@
+//
+// CHIP-8 emulator
+//
+// By Jaldhar H. Vyas <jaldhar@braincells.com>
+// Copyright (C) 2021, Consolidated Braincells Inc.  All rights reserved.
+// "Do what thou wilt" shall be the whole of the license.
+//
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+#include "recorder.h"
+
+constexpr static int FPS = 60;
+
+constexpr static uint8_t Y4M_BLACK = 16;    // studio range luma
+constexpr static uint8_t Y4M_WHITE = 235;
+constexpr static uint8_t Y4M_CHROMA = 128;  // no color
+
+constexpr static int GIF_MIN_CODE_SIZE = 2; // the palette has 2 colors
+constexpr static int GIF_CLEAR = 1 << GIF_MIN_CODE_SIZE;
+constexpr static int GIF_END = GIF_CLEAR + 1;
+constexpr static int GIF_MAX_CODE = 4095;
+constexpr static int GIF_MIN_DELAY = 2;     // browsers slow anything shorter
+
+Recorder::Recorder(const char* filename, int scale, Mode mode) : frames_{},
+mutex_{}, ready_{}, room_{}, closing_{false}, mode_{mode}, lost_{0},
+dropped_{0}, output_{}, format_{Format::Y4M}, scale_{scale},
+width_{SCREEN_WIDTH * scale}, height_{SCREEN_HEIGHT * scale},
+pixels_(width_ * height_), ticks_{0}, encoder_{} {
+    std::string extension;
+    const char* dot = std::strrchr(filename, '.');
+    if (dot) {
+        for (const char* c = dot + 1; *c; c++) {
+            extension += std::tolower(static_cast<unsigned char>(*c));
+        }
+    }
+
+    if (extension == "y4m") {
+        format_ = Format::Y4M;
+    } else if (extension == "gif") {
+        format_ = Format::GIF;
+    } else {
+        throw std::runtime_error("the file name must end in .y4m or .gif");
+    }
+
+    output_.open(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!output_.is_open()) {
+        throw std::runtime_error("could not create file");
+    }
+
+    if (format_ == Format::GIF) {
+        writeGifHeader();
+    } else {
+        writeY4MHeader();
+    }
+
+    encoder_ = std::thread(&Recorder::encode, this);
+}
+
+Recorder::~Recorder() {
+    try {
+        close();
+    } catch (...) {
+    }
+}
+
+// Waits for every frame recorded so far to be written.
+void Recorder::close() {
+    if (!encoder_.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closing_ = true;
+    }
+    ready_.notify_one();
+    encoder_.join();
+
+    if (format_ == Format::GIF) {
+        output_.put(0x3B);                  // trailer
+    }
+    output_.close();
+
+    if (!output_) {
+        throw std::runtime_error("could not write file");
+    }
+}
+
+// The number of frames which were dropped because the encoder was behind.
+uint64_t Recorder::dropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+}
+
+// The mutex is only held by the encoder while it checks whether to sleep,
+// so locking it to wake the encoder up doesn't keep the caller waiting.
+void Recorder::record(const Chip8VM& vm) {
+    Entry entry;
+    for (auto row = 0; row < SCREEN_HEIGHT; row++) {
+        entry.frame[row] = vm.displayRow(row);
+    }
+    entry.ticks = 1 + lost_;
+
+    if (!frames_.push(entry)) {
+        if (mode_ == Mode::DROP) {
+            lost_++;
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        room_.wait(lock, [this, &entry] { return frames_.push(entry); });
+    }
+    lost_ = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+    }
+    ready_.notify_one();
+}
+
+// Runs on the encoder thread.  A frame isn't written until the next
+// different one arrives so that a GIF can show it for as long as it lasted
+// instead of repeating it.
+void Recorder::encode() {
+    Entry entry;
+    Frame pending{};
+    int ticks = 0;                          // how long pending was shown
+
+    for (;;) {
+        if (!frames_.pop(entry)) {
+            // Anything recorded before close() was called is in the queue
+            // by the time closing_ is seen.
+            std::unique_lock<std::mutex> lock(mutex_);
+            ready_.wait(lock, [this] {
+                return frames_.size() || closing_;
+            });
+            if (!frames_.pop(entry)) {
+                ticks += lost_;             // dropped at the very end
+                break;
+            }
+        }
+
+        if (mode_ == Mode::WAIT) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+            }
+            room_.notify_one();
+        }
+
+        // Dropped frames are made up for by showing pending for longer.
+        const auto& frame = entry.frame;
+        ticks += entry.ticks - 1;
+
+        if (ticks && frame == pending) {
+            ticks++;
+            continue;
+        }
+        // A GIF frame too short to be shown properly is replaced by the
+        // next one, which starts when it would have.
+        if (ticks && format_ == Format::GIF && delay(ticks) < GIF_MIN_DELAY) {
+            pending = frame;
+            ticks++;
+            continue;
+        }
+        if (ticks) {
+            writeFrame(pending, ticks);
+        }
+        pending = frame;
+        ticks = 1;
+    }
+
+    if (ticks) {
+        writeFrame(pending, ticks);
+    }
+}
+
+// The GIF delay in hundredths of a second of a frame shown for ticks after
+// those written so far.  It is worked out from the total time so that
+// rounding errors don't add up.
+int Recorder::delay(int ticks) const {
+    return static_cast<int>(((ticks_ + ticks) * 100 / FPS) -
+        (ticks_ * 100 / FPS));
+}
+
+void Recorder::writeFrame(const Frame& frame, int ticks) {
+    if (format_ == Format::GIF) {
+        writeGifFrame(frame, ticks);
+    } else {
+        for (auto i = 0; i < ticks; i++) {
+            writeY4MFrame(frame);
+        }
+    }
+    ticks_ += ticks;
+}
+
+// Fills pixels_ with the scaled up frame.
+static void scaleFrame(const std::array<uint64_t, SCREEN_HEIGHT>& frame,
+int scale, uint8_t off, uint8_t on, std::vector<uint8_t>& pixels) {
+    auto width = SCREEN_WIDTH * scale;
+    auto line = pixels.begin();
+
+    for (auto row = 0; row < SCREEN_HEIGHT; row++) {
+        auto out = line;
+        for (auto col = 0; col < SCREEN_WIDTH; col++) {
+            out = std::fill_n(out, scale, ((frame[row] >> col) & 1) ? on : off);
+        }
+        for (auto i = 1; i < scale; i++) {
+            out = std::copy_n(line, width, out);
+        }
+        line = out;
+    }
+}
+
+// A 2 color palette and a loop forever extension.  Numbers are
+// little-endian.
+void Recorder::writeGifHeader() {
+    auto put16 = [this](int value) {
+        output_.put(static_cast<char>(value & 0xFF));
+        output_.put(static_cast<char>((value >> 8) & 0xFF));
+    };
+
+    output_.write("GIF89a", 6);
+    put16(width_);
+    put16(height_);
+    output_.put(static_cast<char>(0x80));   // global palette of 2 colors
+    output_.put(0);                         // background color
+    output_.put(0);                         // square pixels
+    output_.write("\x00\x00\x00\xFF\xFF\xFF", 6);
+
+    output_.write("\x21\xFF\x0B" "NETSCAPE2.0" "\x03\x01\x00\x00\x00", 19);
+}
+
+// Only the last frame can be shorter than GIF_MIN_DELAY; it is stretched.
+void Recorder::writeGifFrame(const Frame& frame, int ticks) {
+    auto put16 = [this](int value) {
+        output_.put(static_cast<char>(value & 0xFF));
+        output_.put(static_cast<char>((value >> 8) & 0xFF));
+    };
+
+    output_.write("\x21\xF9\x04\x00", 4);   // graphic control extension
+    put16(std::clamp(delay(ticks), GIF_MIN_DELAY, 0xFFFF));
+    output_.write("\x00\x00", 2);
+
+    output_.put(0x2C);                      // image descriptor
+    put16(0);
+    put16(0);
+    put16(width_);
+    put16(height_);
+    output_.put(0);
+    output_.put(GIF_MIN_CODE_SIZE);
+
+    scaleFrame(frame, scale_, 0, 1, pixels_);
+
+    // LZW.  children[code * 2 + pixel] is the code for code followed by
+    // pixel or 0 if there isn't one yet.  Codes are packed least
+    // significant bit first into blocks of up to 255 bytes.
+    std::vector<uint16_t> children(2 * (GIF_MAX_CODE + 1), 0);
+    std::string block;
+    uint32_t bits = 0;
+    int count = 0;
+    int size = GIF_MIN_CODE_SIZE + 1;
+    int last = GIF_END;
+
+    auto emit = [&](int code) {
+        bits |= static_cast<uint32_t>(code) << count;
+        count += size;
+        while (count >= 8) {
+            block += static_cast<char>(bits & 0xFF);
+            bits >>= 8;
+            count -= 8;
+            if (block.size() == 255) {
+                output_.put(static_cast<char>(block.size()));
+                output_.write(block.data(), block.size());
+                block.clear();
+            }
+        }
+    };
+
+    emit(GIF_CLEAR);
+    int prefix = pixels_[0];
+    for (std::size_t i = 1; i < pixels_.size(); i++) {
+        int pixel = pixels_[i];
+        auto& child = children[prefix * 2 + pixel];
+        if (child) {
+            prefix = child;
+            continue;
+        }
+
+        emit(prefix);
+        child = ++last;
+        if (last >= (1 << size)) {
+            size++;
+        }
+        if (last == GIF_MAX_CODE) {
+            emit(GIF_CLEAR);
+            std::fill(children.begin(), children.end(), 0);
+            size = GIF_MIN_CODE_SIZE + 1;
+            last = GIF_END;
+        }
+        prefix = pixel;
+    }
+    emit(prefix);
+    emit(GIF_END);
+
+    if (count) {
+        block += static_cast<char>(bits & 0xFF);
+    }
+    if (!block.empty()) {
+        output_.put(static_cast<char>(block.size()));
+        output_.write(block.data(), block.size());
+    }
+    output_.put(0);                         // end of image data
+}
+
+void Recorder::writeY4MHeader() {
+    output_ << "YUV4MPEG2 W" << width_ << " H" << height_ << " F" << FPS
+        << ":1 Ip A1:1 C444\n";
+}
+
+// Planar Y, U and V at full resolution; a monochrome display only needs Y.
+void Recorder::writeY4MFrame(const Frame& frame) {
+    scaleFrame(frame, scale_, Y4M_BLACK, Y4M_WHITE, pixels_);
+
+    output_ << "FRAME\n";
+    output_.write(reinterpret_cast<const char*>(pixels_.data()),
+        pixels_.size());
+    std::fill(pixels_.begin(), pixels_.end(), Y4M_CHROMA);
+    output_.write(reinterpret_cast<const char*>(pixels_.data()),
+        pixels_.size());
+    output_.write(reinterpret_cast<const char*>(pixels_.data()),
+        pixels_.size());
+}
@@ -0,0 +1,232 @@
+//
+// CHIP-8 emulator
+//
+// By Jaldhar H. Vyas <jaldhar@braincells.com>
+// Copyright (C) 2021, Consolidated Braincells Inc.  All rights reserved.
+// "Do what thou wilt" shall be the whole of the license.
+//
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include "rom.h"
+
+Rom::Rom(const char* filename) : image_{}, size_{0} {
+    std::ifstream input(filename, std::ios::in | std::ios::binary);
+    if (!input.is_open()) {
+        throw std::runtime_error("could not open file");
+    }
+
+    // Read straight into the image.  If it is filled, peeking for another
+    // byte tells us if the file is too big without having to seek.
+    input.read(reinterpret_cast<char*>(image_.data()), image_.size());
+    size_ = input.gcount();
+    if (input.bad()) {
+        throw std::runtime_error("could not read file");
+    }
+    if (size_ == image_.size() &&
+    input.peek() != std::ifstream::traits_type::eof()) {
+        throw std::length_error("file is too big to be a ROM");
+    }
+}
+
+Rom::Rom(const uint8_t* data, std::size_t size) : image_{}, size_{size} {
+    if (size_ > image_.size()) {
+        throw std::length_error("data is too big to be a ROM");
+    }
+    std::copy_n(data, size_, image_.begin());
+}
+
+const uint8_t* Rom::data() const {
+    return image_.data();
+}
+
+std::string Rom::hash() const {
+    return sha1(image_.data(), size_);
+}
+
+std::size_t Rom::size() const {
+    return size_;
+}
+
+static bool parseQuirks(const std::string& field, Quirks& quirks) {
+    quirks = Quirks{ false, false, false, false, false };
+
+    std::istringstream list(field);
+    std::string quirk;
+    while (std::getline(list, quirk, ',')) {
+        if (quirk == "logic") {
+            quirks.logic = true;
+        } else if (quirk == "shift") {
+            quirks.shift = true;
+        } else if (quirk == "memoryLeaveIUnchanged") {
+            quirks.memoryLeaveIUnchanged = true;
+        } else if (quirk == "jump") {
+            quirks.jump = true;
+        } else if (quirk == "wrap") {
+            quirks.wrap = true;
+        } else {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+RomLibrary::RomLibrary() : index_{} {
+}
+
+void RomLibrary::loadIndex(const char* filename) {
+    std::ifstream input(filename);
+    if (!input.is_open()) {
+        throw std::runtime_error("could not open index");
+    }
+
+    std::string line;
+    std::size_t lineno = 0;
+    while (std::getline(input, line)) {
+        lineno++;
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        std::vector<std::string> fields;
+        std::istringstream columns(line);
+        std::string field;
+        while (std::getline(columns, field, '\t')) {
+            fields.push_back(field);
+        }
+        fields.resize(6, "-");
+
+        auto& hash = fields[0];
+        std::transform(hash.begin(), hash.end(), hash.begin(),
+            [](unsigned char c) { return std::tolower(c); });
+        if (hash.size() != 40 ||
+        !std::all_of(hash.begin(), hash.end(),
+        [](unsigned char c) { return std::isxdigit(c); })) {
+            throw std::runtime_error("bad hash at line " +
+                std::to_string(lineno));
+        }
+
+        RomInfo info;
+        if (fields[1] != "-") {
+            info.title = fields[1];
+        }
+        if (fields[2] != "-") {
+            info.platform = fields[2];
+        }
+        if (fields[3] != "-") {
+            try {
+                info.tickrate = std::stoi(fields[3]);
+            } catch (...) {
+                throw std::runtime_error("bad tickrate at line " +
+                    std::to_string(lineno));
+            }
+        }
+        if (fields[4] != "-" && !parseQuirks(fields[4], info.quirks)) {
+            throw std::runtime_error("bad quirks at line " +
+                std::to_string(lineno));
+        }
+        if (fields[5] != "-") {
+            if (fields[5].size() != 16) {
+                throw std::runtime_error("bad keys at line " +
+                    std::to_string(lineno));
+            }
+            info.keys = fields[5];
+        }
+
+        index_[hash] = info;
+    }
+}
+
+const RomInfo* RomLibrary::lookup(const Rom& rom) const {
+    auto entry = index_.find(rom.hash());
+    return (entry != index_.end()) ? &entry->second : nullptr;
+}
+
+std::size_t RomLibrary::size() const {
+    return index_.size();
+}
+
+// FIPS 180-4 SHA-1.  This is what the community database uses to identify
+// ROMs.
+std::string sha1(const uint8_t* data, std::size_t size) {
+    uint32_t h[5] = {
+        0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0
+    };
+
+    auto rotl = [](uint32_t x, int n) { return (x << n) | (x >> (32 - n)); };
+
+    auto block = [&h, &rotl](const uint8_t* chunk) {
+        uint32_t w[80];
+        for (auto i = 0; i < 16; i++) {
+            w[i] = (chunk[i * 4] << 24) | (chunk[i * 4 + 1] << 16) |
+                (chunk[i * 4 + 2] << 8) | chunk[i * 4 + 3];
+        }
+        for (auto i = 16; i < 80; i++) {
+            w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (auto i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            uint32_t temp = rotl(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotl(b, 30);
+            b = a;
+            a = temp;
+        }
+
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    };
+
+    std::size_t whole = size & ~static_cast<std::size_t>(63);
+    for (std::size_t i = 0; i < whole; i += 64) {
+        block(data + i);
+    }
+
+    // The remainder, followed by a 1 bit, padding and the length in bits.
+    uint8_t tail[128] = {};
+    std::size_t rest = size - whole;
+    std::copy_n(data + whole, rest, tail);
+    tail[rest] = 0x80;
+    std::size_t tailSize = (rest < 56) ? 64 : 128;
+    uint64_t bits = static_cast<uint64_t>(size) * 8;
+    for (auto i = 0; i < 8; i++) {
+        tail[tailSize - 1 - i] = static_cast<uint8_t>(bits >> (i * 8));
+    }
+    for (std::size_t i = 0; i < tailSize; i += 64) {
+        block(tail + i);
+    }
+
+    static const char hex[] = "0123456789abcdef";
+    std::string digest;
+    for (auto word : h) {
+        for (auto shift = 28; shift >= 0; shift -= 4) {
+            digest += hex[(word >> shift) & 0xF];
+        }
+    }
+
+    return digest;
+}
@@ -0,0 +1,192 @@
+//
+// CHIP-8 emulator
+//
+// By Jaldhar H. Vyas <jaldhar@braincells.com>
+// Copyright (C) 2021, Consolidated Braincells Inc.  All rights reserved.
+// "Do what thou wilt" shall be the whole of the license.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include "search.h"
+
+Search::Search(const Options& options, Scorer scorer) : options_{options},
+scorer_{scorer} {
+}
+
+// Holds keys down for a number of frames.
+void Search::advance(Chip8VM& vm, uint16_t keys, int frames, int tickrate) {
+    vm.setKeys(keys);
+    for (auto i = 0; i < frames; i++) {
+        vm.run(tickrate);
+        vm.handleInterrupts();
+    }
+}
+
+Search::Result Search::run(const Chip8VM& vm) const {
+    int threads = options_.threads;
+    if (threads <= 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    std::vector<Totals> results(threads);
+    std::vector<std::thread> workers;
+    for (auto i = 1; i < threads; i++) {
+        workers.emplace_back([this, &vm, &results, i] {
+            results[i] = searchTree(vm, options_.seed + i);
+        });
+    }
+    results[0] = searchTree(vm, options_.seed);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    Result best{ options_.actions[0], 0.0, -1 };
+    for (std::size_t action = 0; action < options_.actions.size(); action++) {
+        int visits = 0;
+        double total = 0.0;
+        for (const auto& result : results) {
+            visits += result.visits[action];
+            total += result.total[action];
+        }
+        if (visits > best.visits) {
+            best = Result{ options_.actions[action],
+                visits ? total / visits : 0.0, visits };
+        }
+    }
+
+    return best;
+}
+
+Search::Scorer Search::scoreDisplay(std::function<bool(const Chip8VM&)> test) {
+    return [test](const Chip8VM& vm) {
+        return test(vm) ? 1.0 : 0.0;
+    };
+}
+
+// size bytes at address, big-endian.
+Search::Scorer Search::scoreMemory(uint16_t address, int size) {
+    return [address, size](const Chip8VM& vm) {
+        double value = 0.0;
+        for (auto i = 0; i < size; i++) {
+            value = value * 256 + vm.memoryAt(address + i);
+        }
+        return value;
+    };
+}
+
+// Plays randomly from state for up to options_.depth actions and scores
+// where it ends up.  scratch is reused so nothing is allocated.
+double Search::playout(const Chip8VM& state, Chip8VM& scratch,
+std::minstd_rand& rnd) const {
+    std::uniform_int_distribution<std::size_t> choose(0,
+        options_.actions.size() - 1);
+
+    scratch = state;
+    for (auto i = 0; i < options_.depth && !scratch.faults(); i++) {
+        advance(scratch, options_.actions[choose(rnd)], options_.frames,
+            options_.tickrate);
+    }
+
+    return scorer_(scratch);
+}
+
+// One tree of UCT.  Values are scores relative to the root and are scaled
+// to the range seen so far when comparing children so that the exploration
+// constant doesn't depend on how the ROM keeps score.  A state where the VM
+// has faulted counts as the worst seen.
+Search::Totals Search::searchTree(const Chip8VM& root, uint32_t seed) const {
+    auto actions = options_.actions.size();
+    std::minstd_rand rnd(seed);
+    std::vector<Node> tree;
+    std::vector<int> path;
+    std::vector<std::size_t> untried;
+    Chip8VM scratch(root);
+    auto base = scorer_(root);
+    double low = 0.0;
+    double high = 0.0;
+
+    // Nodes refer to each other by index so the tree can grow but it is
+    // reserved up front anyway to avoid copying.
+    tree.reserve(options_.iterations + 1);
+    tree.push_back(Node{ Pool<Chip8VM>::make(root),
+        std::vector<int>(actions, -1), 0, 0.0, false });
+
+    for (auto iteration = 0; iteration < options_.iterations; iteration++) {
+        int node = 0;
+        path.assign(1, node);
+
+        // Go down the tree until a node with untried actions is found.
+        for (;;) {
+            if (tree[node].done) {
+                break;
+            }
+
+            untried.clear();
+            for (std::size_t action = 0; action < actions; action++) {
+                if (tree[node].children[action] < 0) {
+                    untried.push_back(action);
+                }
+            }
+
+            if (!untried.empty()) {
+                std::uniform_int_distribution<std::size_t> choose(0,
+                    untried.size() - 1);
+                auto action = untried[choose(rnd)];
+
+                auto state = Pool<Chip8VM>::make(*tree[node].state);
+                advance(*state, options_.actions[action], options_.frames,
+                    options_.tickrate);
+                bool done = state->faults() != 0;
+                tree.push_back(Node{ std::move(state),
+                    std::vector<int>(actions, -1), 0, 0.0, done });
+
+                tree[node].children[action] = tree.size() - 1;
+                node = tree.size() - 1;
+                path.push_back(node);
+                break;
+            }
+
+            auto parent = tree[node].visits;
+            auto best = -1;
+            double bestScore = -HUGE_VAL;
+            for (std::size_t action = 0; action < actions; action++) {
+                const auto& child = tree[tree[node].children[action]];
+                double mean = child.total / child.visits;
+                double scaled = (high > low) ? (mean - low) / (high - low) :
+                    0.5;
+                double score = scaled + options_.exploration *
+                    std::sqrt(std::log(parent) / child.visits);
+                if (score > bestScore) {
+                    bestScore = score;
+                    best = tree[node].children[action];
+                }
+            }
+            node = best;
+            path.push_back(node);
+        }
+
+        double value = tree[node].done ? low :
+            playout(*tree[node].state, scratch, rnd) - base;
+        low = std::min(low, value);
+        high = std::max(high, value);
+
+        for (auto n : path) {
+            tree[n].visits++;
+            tree[n].total += value;
+        }
+    }
+
+    Totals totals{ std::vector<int>(actions, 0),
+        std::vector<double>(actions, 0.0) };
+    for (std::size_t action = 0; action < actions; action++) {
+        auto child = tree[0].children[action];
+        if (child >= 0) {
+            totals.visits[action] = tree[child].visits;
+            totals.total[action] = tree[child].total;
+        }
+    }
+
+    return totals;
+}
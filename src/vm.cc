@@ -7,93 +7,235 @@
 //
 
 #include <algorithm>
-#include <fstream>
+#include <cstddef>
+#include "compiled.h"
+#include "opcodes.h"
+#include "rom.h"
 #include "vm.h"
 
-constexpr static int PROGRAM_START = 0x0200;
 constexpr static int FONT_START = 0x0050;
 
+static_assert(MEM_SIZE / CODE_GRANULE == 64, "the code map is a uint64_t");
+static_assert(PagedMemory::PAGE_COUNT <= 16, "the dirty pages are a uint16_t");
+
+// The initial contents of memory; just the font.  It is shared by every VM.
+static std::shared_ptr<const std::array<uint8_t, MEM_SIZE>> fontImage() {
+    static const auto image = [] {
+        auto memory = std::make_shared<std::array<uint8_t, MEM_SIZE>>();
+        memory->fill(0);
+
+        std::array<uint8_t, 80> font {
+            0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
+            0x20, 0x60, 0x20, 0x20, 0x70, // 1
+            0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
+            0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
+            0x90, 0x90, 0xF0, 0x10, 0x10, // 4
+            0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
+            0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
+            0xF0, 0x10, 0x20, 0x40, 0x40, // 7
+            0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
+            0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
+            0xF0, 0x90, 0xF0, 0x90, 0x90, // A
+            0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
+            0xF0, 0x80, 0x80, 0x80, 0xF0, // C
+            0xE0, 0x90, 0x90, 0x90, 0xE0, // D
+            0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
+            0xF0, 0x80, 0xF0, 0x80, 0x80  // F
+        };
+        std::copy(font.begin(), font.end(), &(*memory)[FONT_START]);
+
+        return std::shared_ptr<const std::array<uint8_t, MEM_SIZE>>(memory);
+    }();
+
+    return image;
+}
+
+PagedMemory::PagedMemory(std::shared_ptr<const Image> image) : pages_{},
+dirty_{0}, image_{}, own_{} {
+    reset(image);
+}
+
+PagedMemory::PagedMemory(const PagedMemory& other) : pages_{}, dirty_{0},
+image_{}, own_{} {
+    *this = other;
+}
+
+PagedMemory& PagedMemory::operator=(const PagedMemory& other) {
+    if (this == &other) {
+        return *this;
+    }
+
+    image_ = other.image_;
+    dirty_ = other.dirty_;
+    for (auto page = 0; page < PAGE_COUNT; page++) {
+        if ((dirty_ >> page) & 1) {
+            own_[page] = other.own_[page];
+            pages_[page] = own_[page].bytes;
+        } else {
+            pages_[page] = other.pages_[page];
+        }
+    }
+
+    return *this;
+}
+
+void PagedMemory::copyPage(int page) {
+    std::copy_n(pages_[page], PAGE_SIZE, own_[page].bytes);
+    pages_[page] = own_[page].bytes;
+    dirty_ |= 1 << page;
+}
+
+int PagedMemory::dirtyPages() const {
+    return std::bitset<PAGE_COUNT>(dirty_).count();
+}
+
+const std::shared_ptr<const PagedMemory::Image>& PagedMemory::image() const {
+    return image_;
+}
+
+// Throws away anything written; all of memory is image again.
+void PagedMemory::reset(std::shared_ptr<const Image> image) {
+    image_ = image;
+    dirty_ = 0;
+    for (auto page = 0; page < PAGE_COUNT; page++) {
+        pages_[page] = image_->data() + page * PAGE_SIZE;
+    }
+}
+
+FlatMemory::FlatMemory(std::shared_ptr<const Image> image) : bytes_{},
+image_{} {
+    reset(image);
+}
+
+const std::shared_ptr<const FlatMemory::Image>& FlatMemory::image() const {
+    return image_;
+}
+
+// Throws away anything written; all of memory is image again.
+void FlatMemory::reset(std::shared_ptr<const Image> image) {
+    image_ = image;
+    bytes_ = *image_;
+}
+
+// A different random value for each row so that the same pixels in
+// different rows hash differently.  From splitmix64.
+constexpr static std::array<uint64_t, SCREEN_HEIGHT> ROW_KEYS = [] {
+    std::array<uint64_t, SCREEN_HEIGHT> keys{};
+    uint64_t state = 0;
+    for (auto& key : keys) {
+        state += 0x9E3779B97F4A7C15;
+        auto z = state;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+        key = z ^ (z >> 31);
+    }
+    return keys;
+}();
+
+// The hash of the display is the XOR of the hashes of its rows so it can be
+// updated a row at a time as sprites are drawn.
+constexpr static uint64_t rowHash(int row, uint64_t pixels) {
+    auto h = pixels ^ ROW_KEYS[row];
+    h = (h ^ (h >> 33)) * 0xFF51AFD7ED558CCD;
+    h = (h ^ (h >> 33)) * 0xC4CEB9FE1A85EC53;
+    return h ^ (h >> 33);
+}
+
+constexpr static uint64_t EMPTY_DISPLAY_HASH = [] {
+    uint64_t hash = 0;
+    for (auto row = 0; row < SCREEN_HEIGHT; row++) {
+        hash ^= rowHash(row, 0);
+    }
+    return hash;
+}();
+
+// Bit n is set if any compiled block has code in granule n of memory.
+static uint64_t codeMap(
+const std::array<const CompiledBlock*, MEM_SIZE>& blocks) {
+    uint64_t map = 0;
+    for (const auto block : blocks) {
+        if (!block) {
+            continue;
+        }
+        for (auto address = block->start;
+        address < block->start + block->length * 2; address += 2) {
+            map |= uint64_t{1} << ((address & MEM_MASK) / CODE_GRANULE);
+            map |= uint64_t{1} << (((address + 1) & MEM_MASK) / CODE_GRANULE);
+        }
+    }
+    return map;
+}
+
 Chip8VM::Chip8VM() : V_{}, I_{}, PC_{PROGRAM_START}, SP_{}, DT_{}, ST_{},
-memory_{}, stack_{}, display_{}, keys_{}, rnd_{std::random_device{}()},
-d_{0, 255}, kbstate_{KBState::UNBLOCKED}, optable_{}, optable0_{}, optable8_{},
-optableE_{}, optableF_{} {
-    std::array<uint8_t, 80> font {
-        0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
-        0x20, 0x60, 0x20, 0x20, 0x70, // 1
-        0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
-        0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
-        0x90, 0x90, 0xF0, 0x10, 0x10, // 4
-        0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
-        0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
-        0xF0, 0x10, 0x20, 0x40, 0x40, // 7
-        0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
-        0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
-        0xF0, 0x90, 0xF0, 0x90, 0x90, // A
-        0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
-        0xF0, 0x80, 0x80, 0x80, 0xF0, // C
-        0xE0, 0x90, 0x90, 0x90, 0xE0, // D
-        0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
-        0xF0, 0x80, 0xF0, 0x80, 0x80  // F
-    };
-    std::copy(font.begin(), font.end(), &memory_[FONT_START]);
-
-    optable_[0x0] = &Chip8VM::table0;
-    optable_[0x1] = &Chip8VM::jmp;
-    optable_[0x2] = &Chip8VM::call;
-    optable_[0x3] = &Chip8VM::skip_if_eq_c;
-    optable_[0x4] = &Chip8VM::skip_if_neq_c;
-    optable_[0x5] = &Chip8VM::skip_if_eq_r;
-    optable_[0x6] = &Chip8VM::move_c;
-    optable_[0x7] = &Chip8VM::add_c;
-    optable_[0x8] = &Chip8VM::table8;
-    optable_[0x9] = &Chip8VM::skip_if_neq_r;
-    optable_[0xA] = &Chip8VM::load_i;
-    optable_[0xB] = &Chip8VM::jmp_v0;
-    optable_[0xC] = &Chip8VM::rand;
-    optable_[0xD] = &Chip8VM::draw;
-    optable_[0xE] = &Chip8VM::tableE;
-    optable_[0xF] = &Chip8VM::tableF;
-
-    optable0_.fill(&Chip8VM::no_op);
-    optable0_[0x0] = &Chip8VM::cls;
-    optable0_[0xE] = &Chip8VM::ret;
-
-    optable8_.fill(&Chip8VM::no_op);
-    optable8_[0x0] = &Chip8VM::move_r;
-    optable8_[0x1] = &Chip8VM::bitwise_or;
-    optable8_[0x2] = &Chip8VM::bitwise_and;
-    optable8_[0x3] = &Chip8VM::bitwise_xor;
-    optable8_[0x4] = &Chip8VM::add_r;
-    optable8_[0x5] = &Chip8VM::sub_r;
-    optable8_[0x6] = &Chip8VM::shift_right;
-    optable8_[0x7] = &Chip8VM::sub_n;
-    optable8_[0xE] = &Chip8VM::shift_left;
-
-    optableE_.fill(&Chip8VM::no_op);
-    optableE_[0x1] = &Chip8VM::skip_if_nkey;
-    optableE_[0xE] = &Chip8VM::skip_if_key;
-
-    optableF_.fill(&Chip8VM::no_op);
-    optableF_[0x07] = &Chip8VM::save_delay;
-    optableF_[0x0A] = &Chip8VM::wait_key;
-    optableF_[0x15] = &Chip8VM::load_delay;
-    optableF_[0x18] = &Chip8VM::load_sound;
-    optableF_[0x1E] = &Chip8VM::add_i;
-    optableF_[0x29] = &Chip8VM::font;
-    optableF_[0x33] = &Chip8VM::bcd;
-    optableF_[0x55] = &Chip8VM::save_reg;
-    optableF_[0x65] = &Chip8VM::load_reg;
+faults_{}, kbstate_{KBState::UNBLOCKED}, quirks_{}, keys_{}, cycles_{},
+codeMap_{}, compiled_{}, displayHash_{}, stack_{}, display_{},
+memory_{fontImage()}, rnd_{std::random_device{}()}, d_{0, 255},
+compiledImage_{}, skipped_{}, soundListener_{} {
+    // Chip8VM isn't standard-layout so offsetof is only conditionally
+    // supported, but GCC and clang both support it for classes like this one
+    // without virtual bases.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Winvalid-offsetof"
+    static_assert(offsetof(Chip8VM, displayHash_) <= 64,
+        "everything an instruction normally touches must be in one cache line");
+#pragma GCC diagnostic pop
 
     cls(Instruction{});
 }
 
 void Chip8VM::cycle() {
+#ifdef DEBUG
+    if (breakpoints_.test(PC_ & MEM_MASK)) {
+        halted_ = true;
+        return;
+    }
+#endif
+    execute();
+}
+
+void Chip8VM::execute() {
     auto instruction = fetch();
     decode(instruction);
+    cycles_++;
+}
+
+// Removes the compiled blocks which include any of the bytes from address to
+// address + length - 1.  They will be interpreted from now on.  The blocks
+// may be shared with other VMs so they are copied first.
+void Chip8VM::invalidate(uint16_t address, int length) {
+    auto blocks = std::make_shared<Blocks>(*compiled_);
+    for (auto& block : *blocks) {
+        if (!block) {
+            continue;
+        }
+        for (auto i = 0; i < length; i++) {
+            if (((address + i - block->start) & MEM_MASK) < block->length * 2) {
+                block = nullptr;
+                break;
+            }
+        }
+    }
+    compiled_ = blocks;
+    codeMap_ = codeMap(*compiled_);
+}
+
+// Called after memory is written.  This has to be cheap as it happens on
+// every FX33 and FX55 so only the code map is checked unless the write
+// touches a granule with compiled code in it.
+void Chip8VM::written(uint16_t address, int length) {
+    auto first = (address & MEM_MASK) / CODE_GRANULE;
+    auto last = ((address + length - 1) & MEM_MASK) / CODE_GRANULE;
+    if (((codeMap_ >> first) | (codeMap_ >> last)) & 1) {
+        invalidate(address, length);
+    }
+}
+
+uint64_t Chip8VM::cycles() const {
+    return cycles_;
 }
 
 const Chip8VM::Instruction Chip8VM::fetch() {
-    uint16_t fetched = (memory_[PC_] << 8) | memory_[PC_ + 1];
+    uint16_t fetched = memory_.word(PC_);
     if (kbstate_ == KBState::UNBLOCKED) {
         PC_ += 2;
     }
@@ -105,23 +247,24 @@ const Chip8VM::Instruction Chip8VM::fetch() {
 }
 
 void Chip8VM::decode(const Instruction& instruction) {
-    optable_[instruction.opcode_](this, instruction);
+    uint16_t word = (instruction.opcode_ << 12) | instruction.args_.one.NNN_;
+    (this->*HANDLERS[static_cast<uint8_t>(decodeOp(word))])(instruction);
 }
 
-void Chip8VM::table0(const Instruction& instruction) {
-    optable0_[instruction.args_.three.N_](this, instruction);
+// Bit n of the result is the pixel in column n.
+uint64_t Chip8VM::displayRow(int row) const {
+    return display_[row].to_ullong();
 }
 
-void Chip8VM::table8(const Instruction& instruction) {
-    optable8_[instruction.args_.three.N_](this, instruction);
+// Two displays with the same hash are almost certainly the same.  It is kept
+// up to date as the display changes so it costs nothing to check every
+// frame.
+uint64_t Chip8VM::displayHash() const {
+    return displayHash_;
 }
 
-void Chip8VM::tableE(const Instruction& instruction) {
-    optableE_[instruction.args_.three.N_](this, instruction);
-}
-
-void Chip8VM::tableF(const Instruction& instruction) {
-    optableF_[instruction.args_.two.NN_](this, instruction);
+uint8_t Chip8VM::faults() const {
+    return faults_;
 }
 
 void Chip8VM::handleInterrupts() {
@@ -131,11 +274,67 @@ void Chip8VM::handleInterrupts() {
 
     if (ST_) {
         ST_--;
+
+        if (!ST_ && soundListener_) {
+            soundListener_(cycles_, false);
+        }
+    }
+}
+
+// True if nothing can change until the next call to handleInterrupts() or
+// setKeys(), i.e. the program is waiting for a key or for the delay timer.
+bool Chip8VM::idle() const {
+    switch (kbstate_) {
+    case KBState::BLOCKED:
+        return keys_ == 0;
+    case KBState::RELEASING:
+        // PC is still at the FX0A.
+        return (keys_ >> (V_[memory_[PC_ & MEM_MASK] & 0x0F] & 0xF)) & 1;
+    case KBState::UNBLOCKED:
+        break;
+    }
+
+    return idleLoop() != 0;
+}
+
+// Checks for the loop ROMs use to wait for the delay timer:
+//
+//  FX07    LD  VX, DT
+//  3XNN    SE  VX, NN      (or 4XNN SNE VX, NN)
+//  1NNN    JP  back to the FX07
+//
+// If PC is at the top of such a loop and it will go round again with the
+// current value of the delay timer, returns the number of instructions in
+// it.  Otherwise returns 0.
+int Chip8VM::idleLoop() const {
+    // This is checked before every instruction so most of the time it
+    // should only have to look at one.
+    auto load = memory_.word(PC_);
+    if ((load & 0xF0FF) != 0xF007) {
+        return 0;
+    }
+
+    auto test = memory_.word(PC_ + 2);
+    auto jump = memory_.word(PC_ + 4);
+    if ((test & 0x0F00) != (load & 0x0F00) ||
+    jump != (0x1000 | (PC_ & 0x0FFF))) {
+        return 0;
+    }
+
+    uint8_t nn = test & 0x00FF;
+    switch (test & 0xF000) {
+    case 0x3000:
+        return (DT_ != nn) ? 3 : 0;
+    case 0x4000:
+        return (DT_ == nn) ? 3 : 0;
+    default:
+        return 0;
     }
 }
 
 void Chip8VM::input(Command command, bool up) {
-    keys_[static_cast<uint8_t>(command)] = up;
+    Keys bit = 1 << static_cast<uint8_t>(command);
+    keys_ = up ? (keys_ | bit) : (keys_ & ~bit);
 }
 
 bool Chip8VM::isBeeping() {
@@ -143,33 +342,148 @@ bool Chip8VM::isBeeping() {
 }
 
 void Chip8VM::load(const char* filename) {
-    std::ifstream input(filename, std::ios::in | std::ios::binary);
-    input.exceptions(std::ifstream::failbit);
-    input.seekg(0, std::ios::end);
-    auto sz = input.tellg();
-    input.seekg(0, std::ios::beg);
-    auto contents = new char[sz];
-    input.read(contents, sz);
-    std::copy_n(contents, sz, &memory_[PROGRAM_START]);
-    delete[] contents;
+    load(Rom(filename));
+}
+
+void Chip8VM::load(const Rom& rom) {
+    auto image = std::make_shared<Memory::Image>(*fontImage());
+    std::copy_n(rom.data(), rom.size(), &(*image)[PROGRAM_START]);
+    memory_.reset(image);
+    setCompiled(nullptr);
+}
+
+uint8_t Chip8VM::memoryAt(uint16_t address) const {
+    return memory_[address & MEM_MASK];
+}
+
+void Chip8VM::onSound(SoundListener listener) {
+    soundListener_ = listener;
 }
 
 bool Chip8VM::pixelAt(int height, int width) const {
     return display_[height].test(width);
 }
 
+// A soft reset puts the CPU back in its initial state and clears the
+// display.  A hard reset also restores memory to how it was when the ROM was
+// loaded.  The quirks and random number generator are left alone.
+void Chip8VM::reset(bool hard) {
+    if (ST_ && soundListener_) {
+        soundListener_(cycles_, false);
+    }
+
+    V_.fill(0);
+    I_ = 0;
+    PC_ = PROGRAM_START;
+    SP_ = 0;
+    DT_ = 0;
+    ST_ = 0;
+    faults_ = 0;
+    cycles_ = 0;
+    skipped_ = 0;
+    stack_.fill(0);
+    keys_ = 0;
+    kbstate_ = KBState::UNBLOCKED;
+    cls(Instruction{});
+
+    if (hard) {
+        memory_.reset(memory_.image());
+        if (compiled_ != compiledImage_) {
+            compiled_ = compiledImage_;
+            codeMap_ = codeMap(*compiled_);
+        }
+    }
+}
+
+// Executes count instructions, running compiled blocks where there are any.
+// A block is only run if it fits in what is left of count so the number of
+// instructions executed is exactly the same as if they were interpreted.
+// Time spent idle is skipped over without executing anything, leaving the
+// VM in the same state as if it had been.  Breakpoints are not checked.
+void Chip8VM::run(uint64_t count) {
+    auto target = cycles_ + count;
+    while (cycles_ < target) {
+        // Waiting for a key.  keys_ can't change until we return.
+        if (kbstate_ != KBState::UNBLOCKED && idle()) {
+            skipped_ += target - cycles_;
+            cycles_ = target;
+            break;
+        }
+
+        auto loop = idleLoop();
+        if (loop) {
+            auto iterations = (target - cycles_) / loop;
+            if (iterations) {
+                V_[(memory_[PC_ & MEM_MASK] & 0x0F)] = DT_;
+                skipped_ += iterations * loop;
+                cycles_ += iterations * loop;
+                continue;
+            }
+        }
+
+        auto block = compiled_ ? (*compiled_)[PC_ & MEM_MASK] : nullptr;
+        if (block && kbstate_ == KBState::UNBLOCKED &&
+        block->length <= target - cycles_) {
+            block->run(*this);
+        } else {
+            execute();
+        }
+    }
+}
+
+void Chip8VM::seed(uint32_t value) {
+    rnd_.seed(value);
+    d_.reset();
+}
+
+// The compiled ROM must be the one which is loaded.  Loading another ROM
+// drops it.
+void Chip8VM::setCompiled(const CompiledRom* rom) {
+    if (!rom) {
+        compiled_.reset();
+        compiledImage_.reset();
+        codeMap_ = 0;
+        return;
+    }
+
+    auto blocks = std::make_shared<Blocks>();
+    blocks->fill(nullptr);
+    for (std::size_t i = 0; i < rom->count; i++) {
+        (*blocks)[rom->blocks[i].start & MEM_MASK] = &rom->blocks[i];
+    }
+    compiled_ = compiledImage_ = blocks;
+    codeMap_ = codeMap(*compiled_);
+}
+
+// Bit n of keys is set if key n is down.
+void Chip8VM::setKeys(uint16_t keys) {
+    keys_ = keys;
+}
+
+void Chip8VM::setQuirks(const Quirks& quirks) {
+    quirks_ = quirks;
+}
+
+// How many of cycles() run() skipped through while the program was idle
+// instead of executing them.
+uint64_t Chip8VM::skipped() const {
+    return skipped_;
+}
+
 void Chip8VM::no_op(const Instruction&) {
 }
 
 // 00E0 -   Clear the screen
 void Chip8VM::cls(const Instruction&) {
     std::fill(display_.begin(), display_.end(), 0x00);
+    displayHash_ = EMPTY_DISPLAY_HASH;
 }
 
 // 00EE -   Return from a subroutine
 void Chip8VM::ret(const Instruction&) {
+    faults_ |= (SP_ == 0) * FAULT_STACK_UNDERFLOW;
     SP_--;
-    PC_ = stack_[SP_];
+    PC_ = stack_[SP_ & STACK_MASK];
 }
 
 // 1NNN -   Jump to address NNN
@@ -179,8 +493,9 @@ void Chip8VM::jmp(const Instruction& instruction) {
 
 // 2NNN -   Execute subroutine starting at address NNN
 void Chip8VM::call(const Instruction& instruction) {
-    stack_[SP_] = PC_;
+    stack_[SP_ & STACK_MASK] = PC_;
     SP_++;
+    faults_ |= (SP_ > STACK_SIZE) * FAULT_STACK_OVERFLOW;
     PC_ = instruction.args_.one.NNN_;
 }
 
@@ -225,24 +540,30 @@ void Chip8VM::move_r(const Instruction& instruction) {
 }
 
 // 8XY1 -   Set VX to VX OR VY
-//          VF is set to 0
+//          VF is set to 0 (logic quirk)
 void Chip8VM::bitwise_or(const Instruction& instruction) {
     V_[instruction.args_.three.X_] |= V_[instruction.args_.three.Y_];
-    V_[0xF] = 0;
+    if (quirks_.logic) {
+        V_[0xF] = 0;
+    }
 }
 
 // 8XY2 -   Set VX to VX AND VY
-//          VF is set to 0
+//          VF is set to 0 (logic quirk)
 void Chip8VM::bitwise_and(const Instruction& instruction) {
     V_[instruction.args_.three.X_] &= V_[instruction.args_.three.Y_];
-    V_[0xF] = 0;
+    if (quirks_.logic) {
+        V_[0xF] = 0;
+    }
 }
 
 // 8XY3 -   Set VX to VX XOR VY
-//          VF is set to 0
+//          VF is set to 0 (logic quirk)
 void Chip8VM::bitwise_xor(const Instruction& instruction) {
     V_[instruction.args_.three.X_] ^= V_[instruction.args_.three.Y_];
-    V_[0xF] = 0;
+    if (quirks_.logic) {
+        V_[0xF] = 0;
+    }
 }
 
 // 8XY4 -   Add the value of register VY to register VX
@@ -270,9 +591,12 @@ void Chip8VM::sub_r(const Instruction& instruction) {
 //        in register VX
 //        Set register VF to the least significant bit prior
 //        to the shift
+//        (shift quirk: VX is shifted in place)
 void Chip8VM::shift_right(const Instruction& instruction) {
-    auto lsb = V_[instruction.args_.three.Y_] & 0x01;
-    V_[instruction.args_.three.X_] = V_[instruction.args_.three.Y_] >> 1;
+    auto source = V_[quirks_.shift ? instruction.args_.three.X_ :
+        instruction.args_.three.Y_];
+    auto lsb = source & 0x01;
+    V_[instruction.args_.three.X_] = source >> 1;
     V_[0xF] = lsb;
 }
 
@@ -291,9 +615,12 @@ void Chip8VM::sub_n(const Instruction& instruction) {
 //          bit in register VX
 //          Set register VF to the most significant bit
 //          prior to the shift
+//          (shift quirk: VX is shifted in place)
 void Chip8VM::shift_left(const Instruction& instruction) {
-    auto msb = ((V_[instruction.args_.three.Y_] & 0x80) > 0) ? 1 : 0;
-    V_[instruction.args_.three.X_] = V_[instruction.args_.three.Y_] << 1;
+    auto source = V_[quirks_.shift ? instruction.args_.three.X_ :
+        instruction.args_.three.Y_];
+    auto msb = ((source & 0x80) > 0) ? 1 : 0;
+    V_[instruction.args_.three.X_] = source << 1;
     V_[0xF] = msb;
 }
 
@@ -311,8 +638,10 @@ void Chip8VM::load_i(const Instruction& instruction) {
 }
 
 // BNNN -   Jump to address NNN + V0
+//          (jump quirk: jump to address XNN + VX)
 void Chip8VM::jmp_v0(const Instruction& instruction) {
-    PC_ = instruction.args_.one.NNN_ + V_[0];
+    PC_ = instruction.args_.one.NNN_ +
+        V_[quirks_.jump ? instruction.args_.two.X_ : 0];
 }
 
 // CXNN -   Set VX to a random number with a mask of NN
@@ -323,6 +652,7 @@ void Chip8VM::rand(const Instruction& instruction) {
 // DXYN - Draw a sprite at position VX, VY with N bytes of sprite
 //        data starting at the address stored in I.  Set VF to 01 if
 //        any set pixels are changed to unset, and 00 otherwise
+//        (wrap quirk: sprites wrap around the edges of the screen)
 void Chip8VM::draw(const Instruction& instruction) {
     auto originX = V_[instruction.args_.three.X_] & (SCREEN_WIDTH - 1);
     auto originY = V_[instruction.args_.three.Y_] & (SCREEN_HEIGHT - 1);
@@ -332,16 +662,23 @@ void Chip8VM::draw(const Instruction& instruction) {
         auto posY = originY + row;
 
         if (posY >= SCREEN_HEIGHT) {
-            continue;
+            if (!quirks_.wrap) {
+                continue;
+            }
+            posY &= (SCREEN_HEIGHT - 1);
         }
 
-        auto data = memory_[I_ + row];
+        auto data = memory_[(I_ + row) & MEM_MASK];
+        auto before = display_[posY].to_ullong();
 
         for (uint8_t bit = 0x80,col = 0; bit > 0; bit >>= 1,col++) {
             auto posX = originX + col;
 
             if (posX >= SCREEN_WIDTH) {
-                continue;
+                if (!quirks_.wrap) {
+                    continue;
+                }
+                posX &= (SCREEN_WIDTH - 1);
             }
 
             auto previous = display_[posY].test(posX);
@@ -353,6 +690,9 @@ void Chip8VM::draw(const Instruction& instruction) {
                 V_[0xF] = 1;
             }
         }
+
+        displayHash_ ^= rowHash(posY, before) ^
+            rowHash(posY, display_[posY].to_ullong());
     }
 }
 
@@ -360,7 +700,7 @@ void Chip8VM::draw(const Instruction& instruction) {
 //        corresponding to the hex value currently stored
 //        in register VX is pressed
 void Chip8VM::skip_if_key(const Instruction& instruction) {
-    if (keys_[V_[instruction.args_.two.X_]]) {
+    if ((keys_ >> (V_[instruction.args_.two.X_] & 0xF)) & 1) {
         PC_ += 2;
     }
 }
@@ -369,7 +709,7 @@ void Chip8VM::skip_if_key(const Instruction& instruction) {
 //        corresponding to the hex value currently stored
 //        in register VX is not pressed
 void Chip8VM::skip_if_nkey(const Instruction& instruction) {
-    if (!keys_[V_[instruction.args_.two.X_]]) {
+    if (!((keys_ >> (V_[instruction.args_.two.X_] & 0xF)) & 1)) {
         PC_ += 2;
     }
 }
@@ -389,15 +729,15 @@ void Chip8VM::wait_key(const Instruction& instruction) {
         kbstate_ = KBState::BLOCKED;
         break;
     case KBState::RELEASING:
-        if (!keys_[V_[instruction.args_.two.X_]]) {
+        if (!((keys_ >> (V_[instruction.args_.two.X_] & 0xF)) & 1)) {
             PC_ += 2;
             kbstate_ = KBState::UNBLOCKED;
             break;
         }
         break;
     case KBState::BLOCKED:
-        for (size_t i = 0; i < keys_.size(); i++) {
-            if (keys_[i]) {
+        for (uint8_t i = 0; i < 16; i++) {
+            if ((keys_ >> i) & 1) {
                 V_[instruction.args_.two.X_] = static_cast<uint8_t>(i);
                 kbstate_ = KBState::RELEASING;
                 break;
@@ -414,7 +754,12 @@ void Chip8VM::load_delay(const Instruction& instruction) {
 
 // FX18 -   Set the sound timer to the value of register VX
 void Chip8VM::load_sound(const Instruction& instruction) {
+    bool wasBeeping = ST_ != 0;
     ST_ = V_[instruction.args_.two.X_];
+
+    if (wasBeeping != (ST_ != 0) && soundListener_) {
+        soundListener_(cycles_, ST_ != 0);
+    }
 }
 
 // FX1E -  Add the value stored in register VX to register I
@@ -438,27 +783,35 @@ void Chip8VM::bcd(const Instruction& instruction) {
     auto temp = V_[instruction.args_.two.X_];
 
     for (auto i = 0, power = 100; i < 3; i++, power /= 10) {
-        memory_[I_ + i] = temp / power;
+        memory_.write(I_ + i, temp / power);
         temp = temp % power;
     }
+    written(I_, 3);
 }
 
 // FX55 - Store the values of registers V0 to VX inclusive
 //        in memory starting at address I
 //        I is set to I + X + 1 after operation
+//        (memoryLeaveIUnchanged quirk: I is not changed)
 void Chip8VM::save_reg(const Instruction& instruction) {
     for (auto i = 0; i <= instruction.args_.two.X_; i++) {
-        memory_[I_ + i] = V_[i];
+        memory_.write(I_ + i, V_[i]);
+    }
+    written(I_, instruction.args_.two.X_ + 1);
+    if (!quirks_.memoryLeaveIUnchanged) {
+        I_ += (instruction.args_.two.X_ + 1);
     }
-    I_ += (instruction.args_.two.X_ + 1);
 }
 
 // FX65 -  Fill registers V0 to VX inclusive with the values
 //         stored in memory starting at address I
 //         I is set to I + X + 1 after operation
+//         (memoryLeaveIUnchanged quirk: I is not changed)
 void Chip8VM::load_reg(const Instruction& instruction) {
     for (auto i = 0; i <= instruction.args_.two.X_; i++) {
-        V_[i] = memory_[I_ + i];
+        V_[i] = memory_[(I_ + i) & MEM_MASK];
+    }
+    if (!quirks_.memoryLeaveIUnchanged) {
+        I_ += (instruction.args_.two.X_ + 1);
     }
-    I_ += (instruction.args_.two.X_ + 1);
 }
\ No newline at end of file
@@ -0,0 +1,81 @@
+//
+// CHIP-8 emulator
+//
+// By Jaldhar H. Vyas <jaldhar@braincells.com>
+// Copyright (C) 2021, Consolidated Braincells Inc.  All rights reserved.
+// "Do what thou wilt" shall be the whole of the license.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include "wav.h"
+
+constexpr static uint16_t BITS_PER_SAMPLE = 16;
+constexpr static uint32_t HEADER_SIZE = 44;
+
+WavWriter::WavWriter(const char* filename, uint32_t sampleRate) :
+output_{filename, std::ios::out | std::ios::binary | std::ios::trunc},
+sampleRate_{sampleRate}, samples_{0} {
+    if (!output_.is_open()) {
+        throw std::runtime_error("could not create file");
+    }
+    writeHeader();
+}
+
+WavWriter::~WavWriter() {
+    try {
+        close();
+    } catch (...) {
+    }
+}
+
+void WavWriter::close() {
+    if (!output_.is_open()) {
+        return;
+    }
+
+    output_.seekp(0);
+    writeHeader();
+    output_.close();
+}
+
+void WavWriter::write(float sample) {
+    auto value = static_cast<int16_t>(
+        std::lround(std::clamp(sample, -1.0f, 1.0f) * 32767.0f));
+    char bytes[] = {
+        static_cast<char>(value & 0xFF), static_cast<char>((value >> 8) & 0xFF)
+    };
+    output_.write(bytes, sizeof bytes);
+    samples_++;
+}
+
+// All multi-byte fields are little-endian.
+void WavWriter::writeHeader() {
+    auto put = [this](uint32_t value, int size) {
+        for (auto i = 0; i < size; i++) {
+            output_.put(static_cast<char>((value >> (i * 8)) & 0xFF));
+        }
+    };
+
+    uint32_t dataSize = samples_ * (BITS_PER_SAMPLE / 8);
+    uint16_t blockAlign = BITS_PER_SAMPLE / 8;
+
+    output_.write("RIFF", 4);
+    put(HEADER_SIZE - 8 + dataSize, 4);
+    output_.write("WAVE", 4);
+    output_.write("fmt ", 4);
+    put(16, 4);                             // size of this chunk
+    put(1, 2);                              // PCM
+    put(1, 2);                              // channels
+    put(sampleRate_, 4);
+    put(sampleRate_ * blockAlign, 4);       // bytes per second
+    put(blockAlign, 2);
+    put(BITS_PER_SAMPLE, 2);
+    output_.write("data", 4);
+    put(dataSize, 4);
+
+    if (!output_) {
+        throw std::runtime_error("could not write file");
+    }
+}
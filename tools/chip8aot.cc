@@ -0,0 +1,143 @@
+//
+// CHIP-8 emulator
+//
+// By Jaldhar H. Vyas <jaldhar@braincells.com>
+// Copyright (C) 2021, Consolidated Braincells Inc.  All rights reserved.
+// "Do what thou wilt" shall be the whole of the license.
+//
+
+// Compiles a ROM ahead of time to C++.  The output is meant to be put in the
+// compiled directory so it is built into the emulator.
+
+#include <clocale>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include "analyzer.h"
+#include "opcodes.h"
+#include "rom.h"
+
+static void usage(const char* name) {
+    std::cerr << "Usage: " << name << " [options] rom\n"
+        "  -i index      ROM index to take quirks from\n"
+        "  -o file       write to file instead of standard output\n";
+}
+
+static std::string blockName(uint16_t start) {
+    return "block_" + hex(start, 3);
+}
+
+static void compile(const Analyzer& analyzer, const Rom& rom,
+const char* filename, std::ostream& out) {
+    out << "// Generated by chip8aot from " << filename << ".  Do not edit.\n"
+        "\n"
+        "#include \"compiled.h\"\n"
+        "\n"
+        "namespace {\n";
+
+    for (const auto& block : analyzer.blocks()) {
+        out << "\n"
+            "void " << blockName(block.start) << "(Chip8VM& vm) {\n"
+            "    Runtime rt(vm);\n";
+        for (auto address = block.start; address < block.end; address += 2) {
+            auto word = analyzer.wordAt(address);
+            out << "    rt.execute(0x" << hex(address, 3) << ", 0x"
+                << hex(word, 4) << ");  // " << disassemble(word) << '\n';
+
+            auto op = decodeOp(word);
+            if ((op == Op::BCD || op == Op::SAVE_REG) &&
+            address + 2 < block.end) {
+                out << "    if (!rt.valid(0x" << hex(block.start, 3)
+                    << ")) {\n"
+                    "        return;\n"
+                    "    }\n";
+            }
+        }
+        out << "}\n";
+    }
+
+    out << "\n"
+        "const CompiledBlock blocks[] = {\n";
+    for (const auto& block : analyzer.blocks()) {
+        out << "    { 0x" << hex(block.start, 3) << ", "
+            << (block.end - block.start) / 2 << ", " << blockName(block.start)
+            << " },\n";
+    }
+    out << "};\n"
+        "\n"
+        "const CompiledRom rom {\n"
+        "    \"" << rom.hash() << "\",\n"
+        "    blocks,\n"
+        "    sizeof blocks / sizeof blocks[0]\n"
+        "};\n"
+        "\n"
+        "const bool registered = registerCompiledRom(rom);\n"
+        "\n"
+        "}\n";
+}
+
+int main(int argc, const char* argv[]) {
+    setlocale(LC_ALL, "POSIX");
+
+    const char* index = nullptr;
+    const char* filename = nullptr;
+    const char* output = nullptr;
+
+    for (auto i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-i" && i + 1 < argc) {
+            index = argv[++i];
+        } else if (arg == "-o" && i + 1 < argc) {
+            output = argv[++i];
+        } else if (arg[0] == '-' || filename) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        } else {
+            filename = argv[i];
+        }
+    }
+
+    if (!filename) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    try {
+        Rom rom(filename);
+        Quirks quirks;
+
+        if (index) {
+            RomLibrary library;
+            library.loadIndex(index);
+
+            auto info = library.lookup(rom);
+            if (info) {
+                quirks = info->quirks;
+            }
+        }
+
+        Analyzer analyzer(rom, quirks);
+        if (analyzer.blocks().empty()) {
+            throw std::runtime_error("no code was found");
+        }
+
+        if (output) {
+            std::ofstream file(output);
+            if (!file.is_open()) {
+                throw std::runtime_error("could not open output file");
+            }
+            compile(analyzer, rom, filename, file);
+            if (!file) {
+                throw std::runtime_error("could not write output file");
+            }
+        } else {
+            compile(analyzer, rom, filename, std::cout);
+        }
+    } catch (std::exception& e) {
+        std::cerr << "Could not compile " << filename << ": " << e.what()
+            << '\n';
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,220 @@
+//
+// CHIP-8 emulator
+//
+// By Jaldhar H. Vyas <jaldhar@braincells.com>
+// Copyright (C) 2021, Consolidated Braincells Inc.  All rights reserved.
+// "Do what thou wilt" shall be the whole of the license.
+//
+
+// Runs two ROMs (or one ROM two ways) side by side and reports the first
+// frame where their displays differ.  It can also check a run against the
+// display hashes written by chip8run -l.
+
+#include <cerrno>
+#include <climits>
+#include <clocale>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include "compiled.h"
+#include "opcodes.h"
+#include "rom.h"
+#include "vm.h"
+
+constexpr static int DEFAULT_FRAMES = 600;
+constexpr static int DEFAULT_TICKRATE = 4;
+
+static void usage(const char* name) {
+    std::cerr << "Usage: " << name << " [options] rom [rom]\n"
+        "       " << name << " [options] -l log rom\n"
+        "  -f frames     number of frames to compare (default "
+        << DEFAULT_FRAMES << ")\n"
+        "  -i index      ROM index to take settings from\n"
+        "  -l log        compare with the hashes written by chip8run -l\n"
+        "  -n            interpret the first ROM even if it has been compiled\n"
+        "  -s seed       seed for the random number generators (default 0)\n"
+        "  -t tickrate   instructions per frame\n";
+}
+
+// Loads a ROM and returns its tickrate, which is 0 if the index doesn't say.
+static int setup(Chip8VM& vm, const char* filename, const char* index,
+bool interpret, uint32_t seed) {
+    Rom rom(filename);
+    vm.load(rom);
+    if (!interpret) {
+        vm.setCompiled(findCompiledRom(rom.hash()));
+    }
+    vm.seed(seed);
+
+    if (index) {
+        RomLibrary library;
+        library.loadIndex(index);
+
+        auto info = library.lookup(rom);
+        if (info) {
+            vm.setQuirks(info->quirks);
+            return info->tickrate;
+        }
+    }
+
+    return 0;
+}
+
+// One character per pixel: '#' if lit in both, '1' or '2' if lit in only
+// one of them and '.' if in neither.
+static void showDiff(const Chip8VM& first, const Chip8VM& second) {
+    for (auto row = 0; row < SCREEN_HEIGHT; row++) {
+        std::string line;
+        for (auto col = 0; col < SCREEN_WIDTH; col++) {
+            auto a = first.pixelAt(row, col);
+            auto b = second.pixelAt(row, col);
+            line += (a && b) ? '#' : a ? '1' : b ? '2' : '.';
+        }
+        std::cout << line << '\n';
+    }
+}
+
+static void show(const Chip8VM& vm) {
+    showDiff(vm, vm);
+}
+
+// Parses the whole of value as a number from min to max.
+static bool parseNumber(const char* value, long min, long max, long& number) {
+    char* end;
+    errno = 0;
+    number = std::strtol(value, &end, 10);
+    return end != value && *end == '\0' && errno == 0 && number >= min &&
+        number <= max;
+}
+
+int main(int argc, const char* argv[]) {
+    setlocale(LC_ALL, "POSIX");
+
+    const char* index = nullptr;
+    const char* logfile = nullptr;
+    const char* filenames[2] = { nullptr, nullptr };
+    long frames = DEFAULT_FRAMES;
+    int tickrate = 0;
+    uint32_t seed = 0;
+    bool interpret = false;
+
+    for (auto i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "-n") == 0) {
+            interpret = true;
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0' &&
+        argv[i][2] == '\0' && i + 1 < argc) {
+            const char* value = argv[++i];
+            long number = 0;
+            auto valid = true;
+            switch (argv[i - 1][1]) {
+                case 'f':
+                    valid = parseNumber(value, 0, LONG_MAX, frames);
+                    break;
+                case 'i':
+                    index = value;
+                    break;
+                case 'l':
+                    logfile = value;
+                    break;
+                case 's':
+                    valid = parseNumber(value, 0, UINT32_MAX, number);
+                    seed = number;
+                    break;
+                case 't':
+                    valid = parseNumber(value, 0, INT_MAX, number);
+                    tickrate = number;
+                    break;
+                default:
+                    valid = false;
+                    break;
+            }
+            if (!valid) {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else if (argv[i][0] == '-' || filenames[1]) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        } else {
+            filenames[filenames[0] ? 1 : 0] = argv[i];
+        }
+    }
+
+    if (!filenames[0] || (logfile && filenames[1]) || frames < 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // Without a second ROM, the first is compared with itself, which is
+    // useful with -n to check a compiled ROM against the interpreter.
+    if (!filenames[1]) {
+        filenames[1] = filenames[0];
+    }
+
+    Chip8VM vms[2];
+    int tickrates[2] = { 0, 0 };
+    std::ifstream log;
+
+    for (auto i = 0; i < (logfile ? 1 : 2); i++) {
+        try {
+            tickrates[i] = setup(vms[i], filenames[i], index,
+                interpret && i == 0, seed);
+        } catch (std::exception& e) {
+            std::cerr << "Could not load " << filenames[i] << ": " << e.what()
+                << '\n';
+            return EXIT_FAILURE;
+        }
+
+        if (tickrate > 0 || tickrates[i] <= 0) {
+            tickrates[i] = (tickrate > 0) ? tickrate : DEFAULT_TICKRATE;
+        }
+    }
+
+    if (logfile) {
+        log.open(logfile);
+        if (!log) {
+            std::cerr << "Could not open " << logfile << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+
+    for (long frame = 0; frame < frames; frame++) {
+        vms[0].run(tickrates[0]);
+        vms[0].handleInterrupts();
+
+        if (logfile) {
+            std::string line;
+            if (!std::getline(log, line)) {
+                std::cout << "The log ends before frame " << frame << '\n';
+                return EXIT_FAILURE;
+            }
+
+            auto expected = std::strtoull(line.c_str(), nullptr, 16);
+            if (vms[0].displayHash() != expected) {
+                std::cout << "Frame " << frame << " differs: "
+                    << hex(vms[0].displayHash(), 16) << " instead of "
+                    << hex(expected, 16) << '\n';
+                show(vms[0]);
+                return EXIT_FAILURE;
+            }
+            continue;
+        }
+
+        vms[1].run(tickrates[1]);
+        vms[1].handleInterrupts();
+
+        if (vms[0].displayHash() != vms[1].displayHash()) {
+            std::cout << "Frame " << frame << " differs (1 = " << filenames[0]
+                << ", 2 = " << filenames[1] << "):\n";
+            showDiff(vms[0], vms[1]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::cout << frames << " frames are the same\n";
+
+    return EXIT_SUCCESS;
+}
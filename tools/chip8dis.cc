@@ -0,0 +1,148 @@
+//
+// CHIP-8 emulator
+//
+// By Jaldhar H. Vyas <jaldhar@braincells.com>
+// Copyright (C) 2021, Consolidated Braincells Inc.  All rights reserved.
+// "Do what thou wilt" shall be the whole of the license.
+//
+
+// Disassembles a ROM, separating code from data.
+
+#include <clocale>
+#include <cstdlib>
+#include <iostream>
+#include "analyzer.h"
+#include "opcodes.h"
+#include "rom.h"
+
+constexpr static int BYTES_PER_LINE = 8;
+
+static void usage(const char* name) {
+    std::cerr << "Usage: " << name << " [options] rom\n"
+        "  -b            list the basic blocks instead of the program\n"
+        "  -i index      ROM index to take quirks from\n";
+}
+
+static const char* flowName(Flow flow) {
+    switch (flow) {
+        case Flow::NEXT:
+            return "falls through";
+        case Flow::SKIP:
+            return "skips";
+        case Flow::JUMP:
+            return "jumps";
+        case Flow::CALL:
+            return "calls";
+        case Flow::RETURN:
+            return "returns";
+        case Flow::INDIRECT:
+            return "jumps indirectly";
+    }
+    return "";
+}
+
+static void listBlocks(const Analyzer& analyzer) {
+    for (const auto& block : analyzer.blocks()) {
+        std::cout << hex(block.start, 3) << '-' << hex(block.end - 1, 3)
+            << "  " << flowName(block.flow);
+        for (auto successor : block.successors) {
+            std::cout << ' ' << hex(successor, 3);
+        }
+        std::cout << '\n';
+    }
+}
+
+// Data which is drawn is shown as a bitmap.  Data which is never referred
+// to is packed several bytes to a line.
+static void listProgram(const Analyzer& analyzer) {
+    uint16_t address = PROGRAM_START;
+    while (address < analyzer.end()) {
+        if (analyzer.isInstruction(address) && address + 1 < analyzer.end()) {
+            auto word = analyzer.wordAt(address);
+            if (analyzer.isLeader(address)) {
+                std::cout << 'L' << hex(address, 3) << ":\n";
+            }
+            std::cout << hex(address, 3) << "  " << hex(word, 4) << "  "
+                << disassemble(word) << '\n';
+            address += 2;
+        } else if (analyzer.kindAt(address) == Analyzer::Kind::DATA) {
+            auto byte = analyzer.byteAt(address);
+            std::cout << hex(address, 3) << "  " << hex(byte, 2) << "    DB   "
+                << hex(byte, 2) << "  ; ";
+            for (uint8_t bit = 0x80; bit > 0; bit >>= 1) {
+                std::cout << ((byte & bit) ? '#' : '.');
+            }
+            std::cout << '\n';
+            address++;
+        } else {
+            std::cout << hex(address, 3) << "  ";
+            std::string bytes;
+            for (auto i = 0; i < BYTES_PER_LINE && address < analyzer.end() &&
+            !analyzer.isInstruction(address) &&
+            analyzer.kindAt(address) != Analyzer::Kind::DATA; i++) {
+                bytes += (i ? ", " : "") + hex(analyzer.byteAt(address), 2);
+                address++;
+            }
+            std::cout << "      DB   " << bytes << '\n';
+        }
+    }
+}
+
+int main(int argc, const char* argv[]) {
+    setlocale(LC_ALL, "POSIX");
+
+    const char* index = nullptr;
+    const char* filename = nullptr;
+    bool blocks = false;
+
+    for (auto i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-b") {
+            blocks = true;
+        } else if (arg == "-i" && i + 1 < argc) {
+            index = argv[++i];
+        } else if (arg[0] == '-' || filename) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        } else {
+            filename = argv[i];
+        }
+    }
+
+    if (!filename) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    try {
+        Rom rom(filename);
+        Quirks quirks;
+
+        if (index) {
+            RomLibrary library;
+            library.loadIndex(index);
+
+            auto info = library.lookup(rom);
+            if (info) {
+                quirks = info->quirks;
+            }
+        }
+
+        Analyzer analyzer(rom, quirks);
+        if (blocks) {
+            listBlocks(analyzer);
+        } else {
+            listProgram(analyzer);
+        }
+
+        for (const auto& note : analyzer.notes()) {
+            std::cout << "; " << hex(note.address, 3) << ": " << note.text
+                << '\n';
+        }
+    } catch (std::exception& e) {
+        std::cerr << "Could not load " << filename << ": " << e.what() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,165 @@
+//
+// CHIP-8 emulator
+//
+// By Jaldhar H. Vyas <jaldhar@braincells.com>
+// Copyright (C) 2021, Consolidated Braincells Inc.  All rights reserved.
+// "Do what thou wilt" shall be the whole of the license.
+//
+
+// libFuzzer target for the interpreter.  Each input is laid out as:
+//
+//  byte 0          quirks; one bit each for logic, shift,
+//                  memoryLeaveIUnchanged, jump and wrap, then
+//                  0x20    run each frame with run(), which skips idle time,
+//                          instead of one cycle() at a time
+//                  0x40    also compile the ROM (implies 0x20)
+//  byte 1          number of key states (K)
+//  bytes 2-2K+1    K 16-bit key states, one bit per key, applied one per
+//                  frame (and repeated if there are fewer than FRAMES)
+//  the rest        the ROM
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "analyzer.h"
+#include "compiled.h"
+#include "rom.h"
+#include "vm.h"
+
+constexpr static int FRAMES = 60;
+constexpr static int TICKRATE = 15;
+
+constexpr static uint8_t USE_RUN = 0x20;
+constexpr static uint8_t USE_COMPILED = 0x40;
+
+// The ROM as compiled.  Blocks replay it the way chip8aot's generated code
+// does, with each instruction fixed at compile time even if the ROM later
+// overwrites it.
+static std::array<uint16_t, MEM_SIZE> words;
+static std::array<uint16_t, MEM_SIZE> ends;
+
+static void runBlock(uint16_t start, Chip8VM& vm) {
+    Runtime rt(vm);
+    for (auto address = start; address < ends[start]; address += 2) {
+        auto word = words[address];
+        rt.execute(address, word);
+
+        auto op = decodeOp(word);
+        if ((op == Op::BCD || op == Op::SAVE_REG) &&
+        address + 2 < ends[start] && !rt.valid(start)) {
+            return;
+        }
+    }
+}
+
+// A CompiledFunction is only given the VM so every address where a block
+// could start gets a function of its own.
+template<uint16_t START>
+static void compiledBlock(Chip8VM& vm) {
+    runBlock(START, vm);
+}
+
+template<std::size_t... START>
+constexpr static std::array<CompiledFunction, MEM_SIZE> makeBlockFunctions(
+std::index_sequence<START...>) {
+    return {{ &compiledBlock<START>... }};
+}
+
+constexpr static std::array<CompiledFunction, MEM_SIZE> BLOCK_FUNCTIONS =
+    makeBlockFunctions(std::make_index_sequence<MEM_SIZE>{});
+
+static const CompiledRom* compile(const Rom& rom, const Quirks& quirks) {
+    static std::vector<CompiledBlock> blocks;
+    static CompiledRom compiled{};
+
+    Analyzer analyzer(rom, quirks);
+    blocks.clear();
+    for (const auto& block : analyzer.blocks()) {
+        for (auto address = block.start; address < block.end; address += 2) {
+            words[address] = analyzer.wordAt(address);
+        }
+        ends[block.start] = block.end;
+        blocks.push_back(CompiledBlock{ block.start,
+            static_cast<uint16_t>((block.end - block.start) / 2),
+            BLOCK_FUNCTIONS[block.start] });
+    }
+    compiled = CompiledRom{ "", blocks.data(), blocks.size() };
+
+    return &compiled;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, std::size_t size) {
+    static Chip8VM vm;
+
+    if (size < 2) {
+        return 0;
+    }
+
+    Quirks quirks;
+    quirks.logic = data[0] & 0x01;
+    quirks.shift = data[0] & 0x02;
+    quirks.memoryLeaveIUnchanged = data[0] & 0x04;
+    quirks.jump = data[0] & 0x08;
+    quirks.wrap = data[0] & 0x10;
+
+    std::size_t nkeys = std::min<std::size_t>(data[1], (size - 2) / 2);
+    const uint8_t* keys = data + 2;
+    const uint8_t* program = keys + (nkeys * 2);
+    std::size_t programSize = std::min<std::size_t>(
+        size - 2 - (nkeys * 2), ROM_MAX_SIZE);
+
+    Rom rom(program, programSize);
+    vm.load(rom);
+    vm.reset();
+    vm.seed(0);
+    vm.setQuirks(quirks);
+    if (data[0] & USE_COMPILED) {
+        vm.setCompiled(compile(rom, quirks));
+    }
+
+    for (auto frame = 0; frame < FRAMES; frame++) {
+        if (nkeys) {
+            auto k = frame % nkeys;
+            vm.setKeys((keys[k * 2] << 8) | keys[k * 2 + 1]);
+        }
+
+        if (data[0] & (USE_RUN | USE_COMPILED)) {
+            vm.run(TICKRATE);
+        } else {
+            for (auto i = 0; i < TICKRATE; i++) {
+                vm.cycle();
+            }
+        }
+        vm.handleInterrupts();
+    }
+
+    return 0;
+}
+
+#ifdef FUZZ_STANDALONE
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+int main(int argc, const char* argv[]) {
+    for (auto i = 1; i < argc; i++) {
+        std::ifstream input(argv[i], std::ios::in | std::ios::binary);
+        if (!input.is_open()) {
+            std::cerr << "Could not open " << argv[i] << '\n';
+            return EXIT_FAILURE;
+        }
+        std::vector<uint8_t> contents((std::istreambuf_iterator<char>(input)),
+            std::istreambuf_iterator<char>());
+
+        std::cout << argv[i] << '\n';
+        LLVMFuzzerTestOneInput(contents.data(), contents.size());
+    }
+
+    return EXIT_SUCCESS;
+}
+#endif
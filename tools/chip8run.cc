@@ -0,0 +1,305 @@
+//
+// CHIP-8 emulator
+//
+// By Jaldhar H. Vyas <jaldhar@braincells.com>
+// Copyright (C) 2021, Consolidated Braincells Inc.  All rights reserved.
+// "Do what thou wilt" shall be the whole of the license.
+//
+
+// Runs a ROM without a window or sound device as fast as possible.
+
+#include <chrono>
+#include <cerrno>
+#include <climits>
+#include <clocale>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include "beeper.h"
+#include "compiled.h"
+#include "recorder.h"
+#include "rom.h"
+#include "vm.h"
+#include "wav.h"
+
+constexpr static int FPS = 60;
+constexpr static int DEFAULT_FRAMES = 600;
+constexpr static int DEFAULT_TICKRATE = 4;
+constexpr static uint32_t DEFAULT_SAMPLE_RATE = 44100;
+constexpr static float FREQUENCY = 440.0f;
+constexpr static int BENCHMARK_COPIES = 100000;
+constexpr static int VIDEO_SCALE = 8;
+
+static void usage(const char* name) {
+    std::cerr << "Usage: " << name << " [options] rom\n"
+        "  -b            report how fast the VM ran and can be copied\n"
+        "  -f frames     number of frames to run (default "
+        << DEFAULT_FRAMES << ")\n"
+        "  -i index      ROM index to take settings from\n"
+        "  -l file       write the hash of the display after each frame\n"
+        "  -n            interpret the ROM even if it has been compiled\n"
+        "  -r rate       sample rate for -w (default "
+        << DEFAULT_SAMPLE_RATE << ")\n"
+        "  -s seed       seed for the random number generator (default 0)\n"
+        "  -t tickrate   instructions per frame (default "
+        << DEFAULT_TICKRATE << ")\n"
+        "  -v file       record the display to a .y4m or .gif file\n"
+        "  -w file       render the sound to a .WAV file\n";
+}
+
+// Parses the whole of value as a number from min to max.
+static bool parseNumber(const char* value, long min, long max, long& number) {
+    char* end;
+    errno = 0;
+    number = std::strtol(value, &end, 10);
+    return end != value && *end == '\0' && errno == 0 && number >= min &&
+        number <= max;
+}
+
+int main(int argc, const char* argv[]) {
+    setlocale(LC_ALL, "POSIX");
+
+    const char* index = nullptr;
+    const char* filename = nullptr;
+    const char* wavfile = nullptr;
+    const char* logfile = nullptr;
+    const char* videofile = nullptr;
+    long frames = DEFAULT_FRAMES;
+    int tickrate = 0;
+    uint32_t sampleRate = DEFAULT_SAMPLE_RATE;
+    uint32_t seed = 0;
+    bool interpret = false;
+    bool benchmark = false;
+
+    for (auto i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "-b") == 0) {
+            benchmark = true;
+        } else if (std::strcmp(argv[i], "-n") == 0) {
+            interpret = true;
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0' &&
+        argv[i][2] == '\0' && i + 1 < argc) {
+            const char* value = argv[++i];
+            long number = 0;
+            auto valid = true;
+            switch (argv[i - 1][1]) {
+                case 'f':
+                    valid = parseNumber(value, 0, LONG_MAX, frames);
+                    break;
+                case 'i':
+                    index = value;
+                    break;
+                case 'l':
+                    logfile = value;
+                    break;
+                case 'r':
+                    valid = parseNumber(value, 1, UINT32_MAX, number);
+                    sampleRate = number;
+                    break;
+                case 's':
+                    valid = parseNumber(value, 0, UINT32_MAX, number);
+                    seed = number;
+                    break;
+                case 't':
+                    valid = parseNumber(value, 0, INT_MAX, number);
+                    tickrate = number;
+                    break;
+                case 'v':
+                    videofile = value;
+                    break;
+                case 'w':
+                    wavfile = value;
+                    break;
+                default:
+                    valid = false;
+                    break;
+            }
+            if (!valid) {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else if (argv[i][0] == '-' || filename) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        } else {
+            filename = argv[i];
+        }
+    }
+
+    if (!filename || frames < 0 || sampleRate == 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    Chip8VM vm;
+    std::unique_ptr<WavWriter> wav;
+    std::ofstream log;
+    std::unique_ptr<Recorder> video;
+
+    try {
+        Rom rom(filename);
+        vm.load(rom);
+        if (!interpret) {
+            vm.setCompiled(findCompiledRom(rom.hash()));
+        }
+
+        if (index) {
+            RomLibrary library;
+            library.loadIndex(index);
+
+            auto info = library.lookup(rom);
+            if (info) {
+                vm.setQuirks(info->quirks);
+                if (!tickrate) {
+                    tickrate = info->tickrate;
+                }
+            }
+        }
+
+        if (wavfile) {
+            wav = std::make_unique<WavWriter>(wavfile, sampleRate);
+        }
+
+        if (videofile) {
+            // Nothing is lost by waiting for the encoder when there is no
+            // real time to keep up with.
+            video = std::make_unique<Recorder>(videofile, VIDEO_SCALE,
+                Recorder::Mode::WAIT);
+        }
+
+        if (logfile) {
+            log.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+            log.open(logfile);
+            log << std::hex << std::uppercase << std::setfill('0');
+        }
+    } catch (std::exception& e) {
+        std::cerr << "Could not load " << filename << ": " << e.what() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    if (tickrate <= 0) {
+        tickrate = DEFAULT_TICKRATE;
+    }
+
+    // The same seed as chip8diff so that a log from one can be checked by
+    // the other.
+    vm.seed(seed);
+
+    // The sound is rendered along the emulated timeline so the result does
+    // not depend on how fast the host is.
+    Beeper beeper(sampleRate, FREQUENCY, tickrate * FPS);
+    double cyclesPerSample = static_cast<double>(tickrate) * FPS / sampleRate;
+    uint64_t samples = 0;
+
+    // Writes the samples before cycle.
+    auto render = [&](uint64_t cycle) {
+        auto end = static_cast<uint64_t>(std::floor(
+            static_cast<double>(cycle) / cyclesPerSample));
+        for (; samples < end; samples++) {
+            wav->write(beeper.sampleAt(samples * cyclesPerSample));
+        }
+    };
+
+    // A frame can have more edges than the queue holds.  Rendering up to
+    // the edge which didn't fit uses up the ones before it.
+    if (wav) {
+        vm.onSound([&](uint64_t cycle, bool on) {
+            if (!beeper.push(cycle, on)) {
+                render(cycle);
+                beeper.push(cycle, on);
+            }
+        });
+    }
+
+    // Only the VM itself is timed, not writing the output files.
+    std::chrono::steady_clock::duration running{};
+
+    for (long frame = 0; frame < frames; frame++) {
+        auto start = std::chrono::steady_clock::now();
+        vm.run(tickrate);
+        vm.handleInterrupts();
+        running += std::chrono::steady_clock::now() - start;
+
+        if (video) {
+            video->record(vm);
+        }
+
+        if (logfile) {
+            try {
+                log << std::setw(16) << vm.displayHash() << '\n';
+            } catch (std::exception& e) {
+                std::cerr << "Could not write " << logfile << ": "
+                    << e.what() << '\n';
+                return EXIT_FAILURE;
+            }
+        }
+
+        if (wav) {
+            render(vm.cycles());
+        }
+
+        if (vm.faults()) {
+            std::cerr << ((vm.faults() & FAULT_STACK_OVERFLOW) ?
+                "Stack overflow" : "Stack underflow") << " in frame "
+                << frame << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (benchmark) {
+        // Cycles skipped while the ROM was idle weren't executed.
+        auto executed = vm.cycles() - vm.skipped();
+        std::chrono::duration<double> elapsed = running;
+        std::cout << executed << " instructions in " << elapsed.count()
+            << "s, " << executed / elapsed.count() / 1e6
+            << " million per second\n";
+
+        // Saving states, as a search does, is mostly the cost of a copy.
+        Chip8VM copy(vm);
+        auto start = std::chrono::steady_clock::now();
+        for (auto i = 0; i < BENCHMARK_COPIES; i++) {
+            copy = vm;
+            vm = copy;
+        }
+        elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << sizeof(Chip8VM) << " byte state, "
+            << BENCHMARK_COPIES * 2 / elapsed.count() / 1e6
+            << " million copies per second\n";
+    }
+
+    if (logfile) {
+        try {
+            log.close();
+        } catch (std::exception& e) {
+            std::cerr << "Could not write " << logfile << ": " << e.what()
+                << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (video) {
+        try {
+            video->close();
+        } catch (std::exception& e) {
+            std::cerr << "Could not write " << videofile << ": " << e.what()
+                << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (wav) {
+        try {
+            wav->close();
+        } catch (std::exception& e) {
+            std::cerr << "Could not write " << wavfile << ": " << e.what()
+                << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,249 @@
+//
+// CHIP-8 emulator
+//
+// By Jaldhar H. Vyas <jaldhar@braincells.com>
+// Copyright (C) 2021, Consolidated Braincells Inc.  All rights reserved.
+// "Do what thou wilt" shall be the whole of the license.
+//
+
+// Plays a ROM by searching for the inputs which give the best score.  With
+// a goal it can be used to check that a ROM can be won.
+
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <clocale>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include "compiled.h"
+#include "rom.h"
+#include "search.h"
+#include "vm.h"
+
+constexpr static int DEFAULT_MOVES = 100;
+constexpr static int MAX_SCORE_SIZE = 8;   // bytes for -m
+
+static void usage(const char* name) {
+    Search::Options defaults;
+
+    std::cerr << "Usage: " << name << " [options] -m address[:size] rom\n"
+        "       " << name << " [options] -x x,y rom\n"
+        "  -a keys       keys to choose from, e.g. 456 (default all)\n"
+        "  -d depth      actions per random playout (default "
+        << defaults.depth << ")\n"
+        "  -f frames     frames each action is held for (default "
+        << defaults.frames << ")\n"
+        "  -g goal       stop when the score reaches goal\n"
+        "  -i index      ROM index to take settings from\n"
+        "  -j threads    threads to search with (default one per CPU)\n"
+        "  -m addr[:n]   score is the n bytes (default 1) at addr (hex)\n"
+        "  -n number     iterations per thread per move (default "
+        << defaults.iterations << ")\n"
+        "  -p moves      number of moves to play (default "
+        << DEFAULT_MOVES << ")\n"
+        "  -s seed       seed for the random number generators\n"
+        "  -t tickrate   instructions per frame (default "
+        << defaults.tickrate << ")\n"
+        "  -x x,y        score is 1 when pixel x,y is set\n";
+}
+
+// Parses the whole of value as a number from min to max.
+static bool parseNumber(const char* value, long min, long max, long& number,
+int base = 10) {
+    char* end;
+    errno = 0;
+    number = std::strtol(value, &end, base);
+    return end != value && *end == '\0' && errno == 0 && number >= min &&
+        number <= max;
+}
+
+static std::string keyNames(uint16_t keys) {
+    std::string names;
+    for (auto key = 0; key < 16; key++) {
+        if ((keys >> key) & 1) {
+            names += "0123456789ABCDEF"[key];
+        }
+    }
+    return names.empty() ? "-" : names;
+}
+
+int main(int argc, const char* argv[]) {
+    setlocale(LC_ALL, "POSIX");
+
+    Search::Options options;
+    const char* index = nullptr;
+    const char* filename = nullptr;
+    const char* keys = "0123456789ABCDEF";
+    const char* goal = nullptr;
+    Search::Scorer scorer;
+    double target = 0.0;
+    long moves = DEFAULT_MOVES;
+    int tickrate = 0;
+
+    for (auto i = 1; i < argc; i++) {
+        if (argv[i][0] == '-' && argv[i][1] != '\0' && argv[i][2] == '\0' &&
+        i + 1 < argc) {
+            const char* value = argv[++i];
+            long number = 0;
+            auto valid = true;
+            switch (argv[i - 1][1]) {
+                case 'a':
+                    keys = value;
+                    break;
+                case 'd':
+                    valid = parseNumber(value, 0, INT_MAX, number);
+                    options.depth = number;
+                    break;
+                case 'f':
+                    valid = parseNumber(value, 1, INT_MAX, number);
+                    options.frames = number;
+                    break;
+                case 'g': {
+                    char* end;
+                    goal = value;
+                    target = std::strtod(value, &end);
+                    valid = end != value && *end == '\0';
+                    break;
+                }
+                case 'i':
+                    index = value;
+                    break;
+                case 'j':
+                    valid = parseNumber(value, 0, INT_MAX, number);
+                    options.threads = number;
+                    break;
+                case 'm': {
+                    std::string arg = value;
+                    auto colon = arg.find(':');
+                    long address, size = 1;
+                    valid = parseNumber(arg.substr(0, colon).c_str(), 0,
+                        MEM_SIZE - 1, address, 16) &&
+                        (colon == std::string::npos ||
+                        parseNumber(arg.substr(colon + 1).c_str(), 1,
+                        MAX_SCORE_SIZE, size));
+                    scorer = Search::scoreMemory(address, size);
+                    break;
+                }
+                case 'n':
+                    valid = parseNumber(value, 1, INT_MAX, number);
+                    options.iterations = number;
+                    break;
+                case 'p':
+                    valid = parseNumber(value, 0, LONG_MAX, moves);
+                    break;
+                case 's':
+                    valid = parseNumber(value, 0, UINT32_MAX, number);
+                    options.seed = number;
+                    break;
+                case 't':
+                    valid = parseNumber(value, 0, INT_MAX, number);
+                    tickrate = number;
+                    break;
+                case 'x': {
+                    int x = 0, y = 0;
+                    valid = std::sscanf(value, "%d,%d", &x, &y) == 2 &&
+                        x >= 0 && x < SCREEN_WIDTH && y >= 0 &&
+                        y < SCREEN_HEIGHT;
+                    scorer = Search::scoreDisplay([x, y](const Chip8VM& vm) {
+                        return vm.pixelAt(y, x);
+                    });
+                    break;
+                }
+                default:
+                    valid = false;
+                    break;
+            }
+            if (!valid) {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else if (argv[i][0] == '-' || filename) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        } else {
+            filename = argv[i];
+        }
+    }
+
+    if (!filename || !scorer || options.frames <= 0 || options.depth < 0 ||
+    options.iterations <= 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // Not pressing anything is always an option.
+    options.actions.assign(1, 0);
+    for (const char* key = keys; *key; key++) {
+        const char* digits = "0123456789ABCDEF";
+        const char* digit = std::strchr(digits, std::toupper(*key));
+        if (!digit) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        options.actions.push_back(1 << (digit - digits));
+    }
+
+    Chip8VM vm;
+
+    try {
+        Rom rom(filename);
+        vm.load(rom);
+        vm.setCompiled(findCompiledRom(rom.hash()));
+
+        if (index) {
+            RomLibrary library;
+            library.loadIndex(index);
+
+            auto info = library.lookup(rom);
+            if (info) {
+                vm.setQuirks(info->quirks);
+                if (!tickrate) {
+                    tickrate = info->tickrate;
+                }
+            }
+        }
+    } catch (std::exception& e) {
+        std::cerr << "Could not load " << filename << ": " << e.what() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    if (tickrate > 0) {
+        options.tickrate = tickrate;
+    }
+    vm.seed(options.seed);
+
+    Search search(options, scorer);
+
+    for (long move = 0; move < moves; move++) {
+        auto result = search.run(vm);
+        Search::advance(vm, result.action, options.frames, options.tickrate);
+
+        auto score = scorer(vm);
+        std::ostringstream gain;
+        gain << std::fixed << std::setprecision(2) << result.value;
+        std::cout << "move " << move << " keys " << keyNames(result.action)
+            << " score " << score << " (gain " << gain.str() << ", visits "
+            << result.visits << ")\n";
+
+        if (vm.faults()) {
+            std::cerr << "The VM faulted\n";
+            return EXIT_FAILURE;
+        }
+        if (goal && score >= target) {
+            std::cout << "Reached the goal in " << move + 1 << " moves\n";
+            return EXIT_SUCCESS;
+        }
+    }
+
+    if (goal) {
+        std::cerr << "Did not reach the goal\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}